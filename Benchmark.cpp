@@ -0,0 +1,54 @@
+// Times the arithmetic builtins on Reals, and a polynomial def twice: once from Real literals, which the compiler
+// specializes to real opcodes, and once over rows, whose input type it cannot know and so guards. CMake builds it
+// twice, StackBench with double and StackBenchExtended with long double; 'cmake --build . --target benchmark' runs both.
+#include "Fifth.h"
+
+#include <chrono>
+#include <cstdio>
+#include <type_traits>
+#include <vector>
+
+using namespace Fifth;
+
+static constexpr size_t Calls = 2000000;
+static constexpr size_t Rows = 200000;
+
+// Nanoseconds per call of fn.
+template<typename F>
+static double timed(size_t calls, F fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < calls; ++n) fn();
+    std::chrono::duration<double, std::nano> spent = std::chrono::steady_clock::now() - start;
+    return spent.count() / double(calls);
+}
+
+int main() {
+    VM vm;
+    std::printf("Real: %s, sizeof(Real) %zu, sizeof(Value) %zu\n", std::is_same_v<Real, double> ? "double" : "long double",
+                sizeof(Real), sizeof(Value));
+
+    const Real left = 3.75, right = 1.25;
+    for (const wchar_t* name: { L"+", L"-", L"*", L"/", L"^", L"%", L"<", L"=" }) {
+        Code* word = vm.dictionary()[name];
+        double ns = timed(Calls, [&] {
+            vm.push(left);
+            vm.push(right);
+            word->exec(&vm);
+            vm.pop();
+        });
+        std::printf("%-8ls %8.2f ns\n", name, ns);
+    }
+
+    // The literal gives the def's input a known type, so every operator compiles to REAL_OP.
+    vm.execute(L"def real-poly 0.5 dup dup * swap 3.0 * + 1.5 - end");
+    std::vector<VM::Row> empty(Rows);
+    double ns = timed(1, [&] { vm.runBatch(vm.dictionary()[L"real-poly"], empty, [](size_t, std::span<const Value>, const Error*) { }); });
+    std::printf("%-8s %8.2f ns\n", "realpoly", ns / double(Rows));
+
+    // Each row's value could be any type, so the same operators compile to GUARDED_OP.
+    vm.execute(L"def poly dup dup * swap 3.0 * + 1.5 - end");
+    std::vector<VM::Row> rows(Rows, VM::Row { Value(Real(0.5)) });
+    ns = timed(1, [&] { vm.runBatch(vm.dictionary()[L"poly"], rows, [](size_t, std::span<const Value>, const Error*) { }); });
+    std::printf("%-8s %8.2f ns\n", "poly", ns / double(Rows));
+    return 0;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Fifth.h"
+
+#include <array>
+#include <functional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace Fifth {
+
+// What host values become on the stack and what they are read back as.
+template<typename T> Value toValue(const T& v) {
+    if constexpr (std::is_same_v<T, Value>)                   return v;
+    else if constexpr (std::is_same_v<T, bool>)               return Integer(v);
+    else if constexpr (std::is_integral_v<T>)                 return Integer(v);
+    else if constexpr (std::is_floating_point_v<T>)           return Real(v);
+    else if constexpr (std::is_convertible_v<T, String>)      return String(v);
+    else static_assert(!sizeof(T), "no conversion to Value");
+}
+
+template<typename T> T fromValue(const Value& v) {
+    if constexpr (std::is_same_v<T, Value>)                   return v;
+    else if constexpr (std::is_same_v<T, bool>)               return isTrue(v);
+    else if constexpr (std::is_integral_v<T>)                 return T(asInteger(v));
+    else if constexpr (std::is_floating_point_v<T>)           return T(asReal(v));
+    else if constexpr (std::is_same_v<T, String>)             return v.index() == STRING ? std::get<STRING>(v) : asString(v);
+    else static_assert(!sizeof(T), "no conversion from Value");
+}
+
+// A member of a host struct as scripts see it. set is null for a const member.
+template<typename T>
+struct Member {
+    const wchar_t* name;
+             Value (*get)(const T&);
+              void (*set)(T&, const Value&);
+};
+
+template<typename> struct MemberOf;
+template<typename C, typename F> struct MemberOf<F C::*> { using Class = C; using Type = F; };
+
+template<auto M>
+constexpr Member<typename MemberOf<decltype(M)>::Class> member(const wchar_t* name) {
+    using C = typename MemberOf<decltype(M)>::Class;
+    using F = typename MemberOf<decltype(M)>::Type;
+    if constexpr (std::is_const_v<F>) return { name, [](const C& r) { return toValue(r.*M); }, nullptr };
+    else return { name, [](const C& r) { return toValue(r.*M); }, [](C& r, const Value& v) { r.*M = fromValue<F>(v); } };
+}
+
+// Specialised for each host struct scripts may see: the type's name and its members, fixed at compile time.
+//
+//     template<> struct Fifth::Binding<Order> {
+//         static constexpr const wchar_t* name = L"order";
+//         static constexpr std::array members { Fifth::member<&Order::quantity>(L"quantity"), ... };
+//     };
+template<typename T> struct Binding;
+
+// Host records handed to scripts in place, neither copied nor owned. install() gives each member a word of its own,
+// name.member to read it and name.member! to write it, that goes straight to the member through the index it was
+// registered with:
+//
+//     book 1 order.price          -> the price of record 1
+//     book 1 9.5 order.price!     -> sets it
+template<typename T>
+class Records: public External {
+private:
+    std::span<T> mRows;
+
+    static T& row(VM* vm) {
+        Integer at = asInteger(vm->pop());
+        Value self = vm->pop();
+        auto* records = self.index() == EXTERNAL ? dynamic_cast<Records*>(std::get<EXTERNAL>(self)) : nullptr;
+        if (records == nullptr) throw Error(Error::TYPE_MISMATCH, String(L"not ") + Binding<T>::name + L" records: " + asString(self));
+        if (at < 0 || size_t(at) >= records->mRows.size()) throw Error(Error::TYPE_MISMATCH, L"no record " + std::to_wstring(at));
+        return records->mRows[size_t(at)];
+    }
+
+public:
+    Records(std::span<T> rows)
+        : mRows(rows)
+    { }
+
+    std::span<T> rows() const { return mRows; }
+
+       bool empty() override      { return mRows.empty(); }
+       void install(VM* vm) override;
+       Real toReal() override     { return Real(mRows.size()); }
+     String toString() override   { return Binding<T>::name + (L"[" + std::to_wstring(mRows.size()) + L"]"); }
+    Integer toInteger() override  { return Integer(mRows.size()); }
+};
+
+template<typename T>
+void Records<T>::install(VM* vm) {
+    String type = Binding<T>::name;
+    for (size_t n = 0; n < Binding<T>::members.size(); ++n) {
+        String word = type + L"." + Binding<T>::members[n].name;
+        vm->builtin(word, [n](VM* vm) {
+            vm->need(2);
+            const T& r = row(vm);
+            vm->push(Binding<T>::members[n].get(r));
+        });
+        if (Binding<T>::members[n].set == nullptr) continue;
+        vm->builtin(word + L"!", [n](VM* vm) {
+            vm->need(3);
+            Value v = vm->pop();
+            Binding<T>::members[n].set(row(vm), v);
+        });
+    }
+}
+
+// A word that pushes a host object, so scripts can name it.
+inline void constant(VM& vm, const String& name, External* x) {
+    vm.builtin(name, [x](VM* vm) { vm->push(x); });
+}
+
+// A word that calls a host function: its arguments come off the stack, the last one on top, and its result, if any,
+// goes back on.
+template<typename R, typename... A>
+void bind(VM& vm, const String& name, std::function<R(A...)> fn) {
+    vm.builtin(name, [fn = std::move(fn)](VM* vm) {
+        vm->need(sizeof...(A));
+        std::array<Value, sizeof...(A)> args;
+        for (size_t n = sizeof...(A); n > 0; --n) args[n - 1] = vm->pop();
+        auto call = [&]<size_t... I>(std::index_sequence<I...>) { return fn(fromValue<std::decay_t<A>>(args[I])...); };
+        if constexpr (std::is_void_v<R>) call(std::index_sequence_for<A...>{});
+        else vm->push(toValue(call(std::index_sequence_for<A...>{})));
+    });
+}
+
+template<typename R, typename... A>
+void bind(VM& vm, const String& name, R (*fn)(A...)) {
+    bind(vm, name, std::function<R(A...)>(fn));
+}
+
+}
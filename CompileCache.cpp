@@ -0,0 +1,291 @@
+#include "CompileCache.h"
+
+#include "cstdio.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+
+namespace Fifth {
+
+static constexpr uint64_t Basis = 14695981039346656037ULL;   // FNV-1a
+static constexpr uint64_t Prime = 1099511628211ULL;
+static constexpr uint32_t Magic = 0x43464946;                // "FIFC"
+
+static uint64_t mix(uint64_t h, const void* data, size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t n = 0; n < size; ++n) h = (h ^ bytes[n]) * Prime;   // NOLINT
+    return h;
+}
+
+static uint64_t mix(uint64_t h, const String& s) {
+    uint64_t size = s.size();
+    return mix(mix(h, &size, sizeof(size)), s.data(), s.size() * sizeof(wchar_t));
+}
+
+// The file holds a header and then the entries one after another, numbers as their bytes and strings as their length
+// followed by their characters. It is meant to be read back on the machine that wrote it.
+struct Bytes {
+    std::vector<char> data;
+               size_t at = 0;
+                 bool ok = true;
+
+    template<typename T> void put(T v) { const char* p = reinterpret_cast<const char*>(&v); data.insert(data.end(), p, p + sizeof(T)); }  // NOLINT
+    void put(const String& s) {
+        put(uint64_t(s.size()));
+        const char* p = reinterpret_cast<const char*>(s.data());                                                                              // NOLINT
+        data.insert(data.end(), p, p + s.size() * sizeof(wchar_t));                                                                           // NOLINT
+    }
+    void put(const Value& v) {
+        put(uint8_t(v.index()));
+        switch (v.index()) {
+        case INTEGER: put(std::get<INTEGER>(v)); break;
+        case REAL:    put(std::get<REAL>(v));    break;
+        case STRING:  put(std::get<STRING>(v));  break;
+        }
+    }
+
+    template<typename T> T get() {
+        T v{};
+        if (!ok || data.size() - at < sizeof(T)) ok = false;
+        else {
+            std::memcpy(&v, data.data() + at, sizeof(T));
+            at += sizeof(T);
+        }
+        return v;
+    }
+    String string() {
+        auto size = get<uint64_t>();
+        if (!ok || (data.size() - at) / sizeof(wchar_t) < size) {
+            ok = false;
+            return {};
+        }
+        String s(size, 0);
+        std::memcpy(s.data(), data.data() + at, size * sizeof(wchar_t));
+        at += size * sizeof(wchar_t);
+        return s;
+    }
+    Value value() {
+        switch (get<uint8_t>()) {
+        case INTEGER: return get<Integer>();
+        case REAL:    return get<Real>();
+        case STRING:  return string();
+        }
+        ok = false;
+        return 0;
+    }
+};
+
+// An entry for what def has just compiled, or nothing if the body holds something that cannot be named: a literal
+// other than a number or string, or a call to a word no longer bound to the name it was defined under.
+std::optional<CompileCache::Entry> CompileCache::capture(VM& vm, const String& name, const String& source, Compiled& body) {
+    Entry entry;
+    entry.name = name;
+    entry.source = source;
+    entry.uses = vm.uses(name);
+    entry.copies = vm.copies(name);
+    entry.key = key(vm, name, source, entry.uses);
+    for (const auto& [local, at]: body.locals()) entry.locals.emplace_back(local, at);
+    for (size_t pc = 0; pc < body.size(); ++pc) {
+        const auto& in = body.get(pc);
+        Op op{ in.op(), 0, {}, {} };
+        switch (in.op()) {
+        case Compiled::PUSH:
+        case Compiled::SYSPUSH:
+            if (in.value().index() > STRING) return std::nullopt;
+            op.value = in.value();
+            break;
+        case Compiled::CALL:
+            op.name = vm.nameOf(in.code());
+            if (op.name.empty() || !vm.dictionary().contains(op.name) || vm.dictionary()[op.name] != in.code()) return std::nullopt;
+            break;
+        case Compiled::GLOBAL: op.name = vm.globals()[size_t(in.by())].name; break;
+        case Compiled::NOP:
+        case Compiled::POP:
+        case Compiled::SYSPOP:
+        case Compiled::RETURN:                                                break;
+        default:               op.by = in.by();                               break;
+        }
+        entry.code.push_back(op);
+    }
+    return entry;
+}
+
+bool CompileCache::contains(uint64_t key) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mKeys.contains(key);
+}
+
+// An entry for name whose source is what the buffer holds next, as a whole definition, and whose word would have the
+// same fingerprint compiled now. A body that calls itself was compiled while name was undefined, and does not do for a
+// redefinition, where name means the word being replaced.
+std::optional<CompileCache::Entry> CompileCache::find(VM& vm, const String& name, const String& buffer) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    bool redefining = vm.dictionary().contains(name);
+    auto recursive = [&](const Op& op) { return op.op == Compiled::CALL && op.name == name; };
+    auto [from, to] = mEntries.equal_range(name);
+    for (auto at = from; at != to; ++at) {
+        const Entry& entry = at->second;
+        size_t size = entry.source.size();
+        if (buffer.compare(0, size, entry.source) != 0 || (buffer.size() > size && !std::iswspace(buffer[size]))) continue;
+        if (key(vm, name, entry.source, entry.uses) != entry.key) continue;
+        if (redefining && std::any_of(entry.code.begin(), entry.code.end(), recursive)) continue;
+        ++mHits;
+        return entry;
+    }
+    return std::nullopt;
+}
+
+uint64_t CompileCache::hash(const String& s) {
+    return mix(mix(Basis, &Version, sizeof(Version)), s);
+}
+
+size_t CompileCache::hits() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mHits;
+}
+
+// A word's fingerprint: its name and source, and the fingerprint of every name it uses.
+uint64_t CompileCache::key(VM& vm, const String& name, const String& source, const std::set<String>& uses) {
+    uint64_t h = mix(hash(name), source);
+    for (const auto& used: uses) {
+        uint64_t print = vm.fingerprint(used);
+        h = mix(mix(h, used), &print, sizeof(print));
+    }
+    return h;
+}
+
+// Adds the entries saved in a file. Returns false, adding none, if it cannot be read or was written by another
+// version, or for another size of Real or wchar_t.
+bool CompileCache::load(const String& path) {
+    cstd::file file(path, cstd::file::mode(cstd::file::Read | cstd::file::Binary));
+    if (!file.isOpen()) return false;
+    Bytes in;
+    while (file.read(in.data, 4096) == 4096) { }
+    if (in.get<uint32_t>() != Magic || in.get<uint32_t>() != Version || in.get<uint32_t>() != sizeof(Real)
+            || in.get<uint32_t>() != sizeof(wchar_t)) return false;
+
+    // Entries are read one at a time, so a corrupt count runs out of bytes instead of asking for memory up front.
+    std::vector<Entry> entries;
+    for (auto count = in.get<uint64_t>(); in.ok && count > 0; --count) {
+        Entry entry;
+        entry.key = in.get<uint64_t>();
+        entry.name = in.string();
+        entry.source = in.string();
+        for (auto n = in.get<uint64_t>(); in.ok && n > 0; --n) entry.uses.insert(in.string());
+        for (auto n = in.get<uint64_t>(); in.ok && n > 0; --n) entry.copies.insert(in.string());
+        for (auto n = in.get<uint64_t>(); in.ok && n > 0; --n) {
+            String local = in.string();
+            size_t offset = in.get<uint64_t>();
+            entry.locals.emplace_back(local, Code::Local{ offset, in.get<uint64_t>() });
+        }
+        for (auto n = in.get<uint64_t>(); in.ok && n > 0; --n) {
+            Op op;
+            if (auto code = in.get<uint8_t>(); code <= Compiled::GUARDED_OP) op.op = Compiled::opCode(code);
+            else in.ok = false;
+            op.by = in.get<int32_t>();
+            op.name = in.string();
+            op.value = in.value();
+            entry.code.push_back(op);
+        }
+        entries.push_back(std::move(entry));
+    }
+    if (!in.ok) return false;
+    for (auto& entry: entries) store(std::move(entry));
+    return true;
+}
+
+// A word built from an entry found for this VM, or nullptr if a name it calls or a global it uses has gone since.
+// Calls to the entry's own name are recursive.
+Compiled* CompileCache::materialize(VM& vm, const Entry& entry) {
+    auto block = new Compiled();                                          // NOLINT
+    auto locals = entry.locals;
+    std::sort(locals.begin(), locals.end(), [](const auto& a, const auto& b) { return a.second.offset < b.second.offset; });
+    for (const auto& [local, at]: locals) {
+        if (block->declare(local, at.size) != at.offset) {
+            delete block;                                                 // NOLINT
+            return nullptr;
+        }
+    }
+    auto& dict = vm.dictionary();
+    for (const auto& op: entry.code) {
+        switch (op.op) {
+        case Compiled::CALL: {
+                Code* code = op.name == entry.name ? block : dict.contains(op.name) ? dict[op.name] : nullptr;
+                if (code == nullptr) {
+                    delete block;                                         // NOLINT
+                    return nullptr;
+                }
+                block->instruction(Compiled::Instruction(op.op, code));
+            }
+            break;
+        case Compiled::GLOBAL: {
+                size_t g = vm.globalOf(op.name);
+                if (g == VM::npos) {
+                    delete block;                                         // NOLINT
+                    return nullptr;
+                }
+                block->instruction(Compiled::Instruction(op.op, int(g)));
+            }
+            break;
+        case Compiled::PUSH:
+        case Compiled::SYSPUSH: block->instruction(Compiled::Instruction(op.op, op.value)); break;
+        case Compiled::NOP:
+        case Compiled::POP:
+        case Compiled::SYSPOP:
+        case Compiled::RETURN:  block->instruction(Compiled::Instruction(op.op));           break;
+        default:                block->instruction(Compiled::Instruction(op.op, op.by));    break;
+        }
+    }
+    return block;
+}
+
+bool CompileCache::save(const String& path) const {
+    Bytes out;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        out.put(Magic);
+        out.put(Version);
+        out.put(uint32_t(sizeof(Real)));
+        out.put(uint32_t(sizeof(wchar_t)));
+        out.put(uint64_t(mEntries.size()));
+        for (const auto& [name, entry]: mEntries) {
+            out.put(entry.key);
+            out.put(entry.name);
+            out.put(entry.source);
+            out.put(uint64_t(entry.uses.size()));
+            for (const auto& used: entry.uses) out.put(used);
+            out.put(uint64_t(entry.copies.size()));
+            for (const auto& copied: entry.copies) out.put(copied);
+            out.put(uint64_t(entry.locals.size()));
+            for (const auto& [local, at]: entry.locals) {
+                out.put(local);
+                out.put(uint64_t(at.offset));
+                out.put(uint64_t(at.size));
+            }
+            out.put(uint64_t(entry.code.size()));
+            for (const auto& op: entry.code) {
+                out.put(uint8_t(op.op));
+                out.put(int32_t(op.by));
+                out.put(op.name);
+                out.put(op.value);
+            }
+        }
+    }
+    cstd::file file(path, cstd::file::mode(cstd::file::Write | cstd::file::Binary));
+    return file.isOpen() && file.write(out.data, 0, out.data.size()) == out.data.size();
+}
+
+size_t CompileCache::size() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries.size();
+}
+
+void CompileCache::store(Entry entry) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mKeys.insert(entry.key).second) return;
+    String name = entry.name;
+    mEntries.emplace(name, std::move(entry));
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Fifth.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Fifth {
+
+// Compiled bodies of words, kept by def so that the same definition met again, by this VM or another, or after a
+// restart through save() and load(), is not tokenized and compiled again. Bodies are stored by name rather than by
+// address: calls name the word they call and globals name the variable. An entry is used only while every name its
+// word referred to stands for the same thing it did, which fingerprint() follows from the word's source down through
+// what it uses. One cache may be shared by several VMs on different threads.
+class CompileCache {
+public:
+    struct Op {
+        Compiled::opCode op = Compiled::NOP;
+                     int by = 0;
+                  String name;    // the word a CALL calls or the global a GLOBAL refers to
+                   Value value;   // what a PUSH or SYSPUSH pushes
+    };
+
+    struct Entry {
+                                      uint64_t key = 0;   // the word's fingerprint when it was compiled
+                                        String name;
+                                        String source;
+                              std::set<String> uses;
+                              std::set<String> copies;
+     std::vector<std::pair<String, Code::Local>> locals;
+                               std::vector<Op> code;
+    };
+
+    static constexpr uint32_t Version = 1;
+
+private:
+    std::multimap<String, Entry> mEntries;
+                          size_t mHits = 0;
+              std::set<uint64_t> mKeys;
+              mutable std::mutex mMutex;
+
+public:
+    CompileCache() = default;
+
+    NO(CompileCache);
+
+    static std::optional<Entry> capture(VM& vm, const String& name, const String& source, Compiled& body);
+                          bool contains(uint64_t key) const;
+          std::optional<Entry> find(VM& vm, const String& name, const String& buffer);
+               static uint64_t hash(const String& s);
+                        size_t hits() const;
+               static uint64_t key(VM& vm, const String& name, const String& source, const std::set<String>& uses);
+                          bool load(const String& path);
+              static Compiled* materialize(VM& vm, const Entry& entry);
+                          bool save(const String& path) const;
+                        size_t size() const;
+                          void store(Entry entry);
+};
+
+}
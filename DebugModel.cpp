@@ -0,0 +1,133 @@
+#include "DebugModel.h"
+
+#include <algorithm>
+
+// Whether a row still shows what it did. Tables, vectors and externals can change behind the same pointer, so a row
+// holding one is always redrawn; the view only formats the rows it has on screen.
+static bool unchanged(const Fifth::Value& a, const Fifth::Value& b) {
+    if (a.index() != b.index()) return false;
+    switch (a.index()) {
+    case Fifth::INTEGER:
+    case Fifth::REAL:
+    case Fifth::STRING:
+    case Fifth::VALUEPTR: return a == b;
+    default:              return false;
+    }
+}
+
+void CodeModel::clear() {
+    beginResetModel();
+    mLines.clear();
+    endResetModel();
+}
+
+void CodeModel::setCode(const QStringList& code) {
+    beginResetModel();
+    mLines = code;
+    endResetModel();
+}
+
+int CodeModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : 2;
+}
+
+QVariant CodeModel::data(const QModelIndex& index, int role) const {
+    if (role != Qt::DisplayRole || !index.isValid() || index.row() >= mLines.size()) return {};
+    const QString& line = mLines[index.row()];
+    return index.column() == 0 ? line.section(',', 1, 1) : line.section(',', 2);
+}
+
+QVariant CodeModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) return QAbstractTableModel::headerData(section, orientation, role);
+    return QString(section == 0 ? "OpCode" : "Arguments");
+}
+
+int CodeModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : int(mLines.size());
+}
+
+void StackModel::refresh() {
+    size_t size = mStack.size();
+    size_t shown = mShown.size();
+    if (size < shown) {
+        beginRemoveRows(QModelIndex(), int(size), int(shown) - 1);
+        mShown.resize(size);
+        endRemoveRows();
+    }
+    size_t first = size, last = 0;
+    for (size_t n = 0; n < std::min(size, shown); ++n) {
+        const Fifth::Value& v = mStack.at(size - 1 - n);
+        if (unchanged(v, mShown[n])) continue;
+        mShown[n] = v;
+        first = std::min(first, n);
+        last = n;
+    }
+    if (first < size) emit dataChanged(index(int(first), 0), index(int(last), 0));
+    if (size > shown) {
+        beginInsertRows(QModelIndex(), int(shown), int(size) - 1);
+        for (size_t n = shown; n < size; ++n) mShown.push_back(mStack.at(size - 1 - n));
+        endInsertRows();
+    }
+}
+
+int StackModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : 1;
+}
+
+QVariant StackModel::data(const QModelIndex& index, int role) const {
+    if (role != Qt::DisplayRole || !index.isValid() || size_t(index.row()) >= mShown.size()) return {};
+    return QString::fromStdWString(mVM->format(mShown[size_t(index.row())]));
+}
+
+int StackModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : int(mShown.size());
+}
+
+void VarsModel::refresh(bool shown) {
+    std::vector<Var> vars;
+    if (shown && mScope == GLOBALS) {
+        const auto& globals = mVM->globals();
+        for (size_t n = 0; n < globals.size(); ++n) vars.push_back({ globals[n].name, *mVM->global(n) });
+    } else if (shown) {
+        if (Fifth::Code* code = mVM->debugFrame(); code != nullptr) {
+            for (const auto& [name, local]: code->locals()) vars.push_back({ name, mVM->frame()[local.offset] });
+        }
+    }
+
+    // Variables come and go only when a word is defined or entered; a step just changes values.
+    bool same = vars.size() == mShown.size();
+    for (size_t n = 0; same && n < vars.size(); ++n) same = vars[n].name == mShown[n].name;
+    if (!same) {
+        beginResetModel();
+        mShown = std::move(vars);
+        endResetModel();
+        return;
+    }
+    size_t first = vars.size(), last = 0;
+    for (size_t n = 0; n < vars.size(); ++n) {
+        if (unchanged(vars[n].value, mShown[n].value)) continue;
+        mShown[n].value = std::move(vars[n].value);
+        first = std::min(first, n);
+        last = n;
+    }
+    if (first < vars.size()) emit dataChanged(index(int(first), 1), index(int(last), 1));
+}
+
+int VarsModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : 2;
+}
+
+QVariant VarsModel::data(const QModelIndex& index, int role) const {
+    if (role != Qt::DisplayRole || !index.isValid() || size_t(index.row()) >= mShown.size()) return {};
+    const Var& var = mShown[size_t(index.row())];
+    return QString::fromStdWString(index.column() == 0 ? var.name : mVM->format(var.value));
+}
+
+QVariant VarsModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) return QAbstractTableModel::headerData(section, orientation, role);
+    return QString(section == 0 ? "Name" : "Value");
+}
+
+int VarsModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : int(mShown.size());
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QStringList>
+
+#include <vector>
+
+#include "Fifth.h"
+
+// The debugger's tables. Each keeps the values the view last saw, formats a row only when the view asks for it, and on
+// refresh() tells the view just which rows came, went or changed, so a step costs a pass over the values rather than
+// rebuilding every cell.
+
+// A word's code as VM::debug() lists it, one "pc,opcode,arguments" line per instruction.
+class CodeModel: public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    CodeModel(QObject* parent = nullptr)
+        : QAbstractTableModel(parent)
+    { }
+
+        void clear();
+        void setCode(const QStringList& code);
+
+         int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+         int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+
+private:
+    QStringList mLines;
+};
+
+// The user or the system stack, bottom first.
+class StackModel: public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    StackModel(Fifth::VM* vm, Fifth::Stack& stack, QObject* parent = nullptr)
+        : QAbstractTableModel(parent)
+        , mVM(vm)
+        , mStack(stack)
+    { }
+
+        void refresh();
+
+         int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+         int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+
+private:
+                   Fifth::VM* mVM;
+                Fifth::Stack& mStack;
+    std::vector<Fifth::Value> mShown;
+};
+
+// The globals, or the locals of the word being stepped through, by name.
+class VarsModel: public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    enum Scope { GLOBALS, LOCALS };
+
+    VarsModel(Fifth::VM* vm, Scope scope, QObject* parent = nullptr)
+        : QAbstractTableModel(parent)
+        , mVM(vm)
+        , mScope(scope)
+    { }
+
+        void refresh(bool shown);
+
+         int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+         int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+
+private:
+    struct Var {
+        Fifth::String name;
+         Fifth::Value value;
+    };
+
+          Fifth::VM* mVM;
+               Scope mScope;
+    std::vector<Var> mShown;
+};
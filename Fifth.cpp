@@ -1,75 +1,384 @@
 #include "Fifth.h"
 
+#include "CompileCache.h"
+#include "Numeric.h"
+#include "Registers.h"
+#include "Simd.h"
 #include "cstdio.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <thread>
+#include <utility>
 
 namespace Fifth {
 
 static constexpr Real Half = 0.5;
 
-static std::wstring toString(VM* vm, Compiled* code, const Value& v) {
+static std::wstring toString(VM* vm, const Value& v) {
     switch (v.index()) {
     case INTEGER:
     case REAL:
     case STRING:
-    case EXTERNAL: return asString(v);
+    case EXTERNAL:
+    case TABLE:
+    case VECTOR:   return asString(v);
     case VALUEPTR: {
             Value* ptr = (Value*) std::get<void*>(v);                                      // NOLINT
-            if (code->reverse().contains(ptr)) return L"local:" + code->reverse()[ptr];
-            else if (vm->reverse().contains(ptr)) return L"global:" + vm->reverse()[ptr];
+            if (String name = vm->localName(ptr); !name.empty()) return L"local:" + name;
+            else if (const VM::Global* g = vm->globalAt(ptr); g != nullptr) return L"global:" + g->name;
             else return L"*" + std::to_wstring((size_t) ptr);                              // NOLINT
         }
     }
     return L"";
 }
 
-static void applyOperator(VM* vm, Value op) {
+static bool isVariable(VM* vm, Code* code, const String& name) {
+    return code->locals().contains(name) || vm->globalOf(name) != VM::npos;
+}
+
+// Locals have no address until their word runs, so a reference to one compiles to its frame slot. Globals compile to
+// their descriptor, which stays put when the global is resized.
+static void compileVariable(VM* vm, Compiled* code, const Value& v) {
+    if (v.index() != STRING) code->push(v);
+    else if (String name = std::get<STRING>(v); code->locals().contains(name)) code->local(code->locals()[name].offset);
+    else if (size_t g = vm->globalOf(name); g != VM::npos) code->global(g);
+    else code->push(v);
+}
+
+// Compiled algebra is parsed into a tree before any code is emitted, so that literal subexpressions can be worked out
+// once here and operators rewritten into cheaper ones. A leaf holds a literal or a name, an operator node the word it
+// calls on what its children leave; a rewritten unary operator has no right child.
+struct Expr {
+                  Value value;
+    std::unique_ptr<Expr> left;
+    std::unique_ptr<Expr> right;
+
+    bool constant() const { return !left && (value.index() == INTEGER || value.index() == REAL); }
+};
+
+// Runs op on two literals now rather than every time the word runs. Declines anything that fails, leaving the error to
+// be raised when the code runs, and anything that does not give a number. Only a builtin is run: a word defined in
+// its place could do anything.
+static std::optional<Value> fold(VM* vm, const String& op, const Value& left, const Value& right) {
+    Code* code = vm->dictionary()[op];
+    if (op == L"[*]" || code->compiled()) return std::nullopt;
+    if (int known = Compiled::operatorOf(op); known != Compiled::OPERATORS && vm->operatorCode(known) != code) return std::nullopt;
+    size_t depth = vm->size();
+    vm->push(left);
+    vm->push(right);
+    try {
+        code->exec(vm);
+    } catch (const Error&) {
+        while (vm->size() > depth) vm->pop();
+        return std::nullopt;
+    }
+    if (vm->size() != depth + 1 || vm->top().index() > REAL) {
+        while (vm->size() > depth) vm->pop();
+        return std::nullopt;
+    }
+    return vm->pop();
+}
+
+static std::unique_ptr<Expr> combine(VM* vm, const String& op, std::unique_ptr<Expr> left, std::unique_ptr<Expr> right) {
+    if (left->constant() && right->constant()) {
+        if (auto value = fold(vm, op, left->value, right->value); value.has_value()) return std::make_unique<Expr>(value.value());
+    }
+    if (op == L"^" && right->constant() && asReal(right->value) == 2) {
+        auto node = std::make_unique<Expr>(String(L"(square)"));
+        node->left = std::move(left);
+        return node;
+    }
+    auto node = std::make_unique<Expr>(op);
+    node->left = std::move(left);
+    node->right = std::move(right);
+    return node;
+}
+
+static void emit(VM* vm, Compiled* code, const Expr& expr) {
+    if (expr.left) {
+        emit(vm, code, *expr.left);
+        if (expr.right) emit(vm, code, *expr.right);
+        code->call(vm->dictionary()[std::get<STRING>(expr.value)]);
+    } else if (expr.value.index() == STRING) {
+        String name = std::get<STRING>(expr.value);
+        if (String var = name[0] == '*' ? name.substr(1) : name; isVariable(vm, code, var)) {
+            compileVariable(vm, code, var);
+            code->call(vm->dictionary()[L"get"]);
+        } else if (vm->dictionary().contains(name)) code->call(vm->dictionary()[name]);
+    } else {
+        code->push(expr.value);
+        if (expr.value.index() == VALUEPTR) code->call(vm->dictionary()[L"get"]);
+    }
+}
+
+// Operands are on the user stack when algebra runs at once, and in the tree when it is compiling.
+static void applyOperator(VM* vm, Value op, std::vector<std::unique_ptr<Expr>>& tree) {
     String name = std::get<String>(op);
     if (vm->compiling()) {
-        Value right = vm->pop();
-        Value left = vm->pop();
-        auto* code = dynamic_cast<Compiled*>(vm->code());
-        if (left.index() != VALUEPTR || std::get<VALUEPTR>(left) != nullptr) {
-            if (left.index() == STRING) {
-                String name = std::get<STRING>(left);
-                if (vm->dictionary().contains(name)) code->call(vm->dictionary()[name]);
-            } else {
-                code->push(left);
-                if (left.index() == VALUEPTR) code->call(vm->dictionary()[L"get"]);
-            }
-        }
-        if (right.index() != VALUEPTR || std::get<VALUEPTR>(right) != nullptr) {
-            if (right.index() == STRING) {
-                String name = std::get<STRING>(right);
-                if (vm->dictionary().contains(name)) code->call(vm->dictionary()[name]);
-            } else {
-                code->push(right);
-                if (right.index() == VALUEPTR) code->call(vm->dictionary()[L"get"]);
-            }
-        }
-        code->call(vm->dictionary()[name]);
-        vm->push((Value*) nullptr);          // Dummy value to keep alorithm happy, but we know not to pus it in the code
+        vm->referred().insert(name);
+        if (tree.size() < 2) throw Error(Error::STACK_UNDERFLOW, L"missing operand for " + name);
+        auto right = std::move(tree.back());
+        tree.pop_back();
+        auto left = std::move(tree.back());
+        tree.pop_back();
+        tree.push_back(combine(vm, name, std::move(left), std::move(right)));
     } else vm->dictionary()[name]->exec(vm);
 }
 
+// The operator (or parenthesis) on top of the system stack while algebra is running.
+static String pending(VM* vm) {
+    Value top = vm->systop();
+    if (top.index() != STRING) throw Error(Error::CONTROL_MISMATCH, L"unbalanced parentheses");
+    return std::get<STRING>(top);
+}
+
+// Whether the pending operator op1 is applied before op2 is pushed: it binds tighter, or as tight and op2 groups to the
+// left, as every operator but ^ does, so that 2 - 3 - 4 is (2 - 3) - 4 and 2 ^ 3 ^ 2 is 2 ^ (3 ^ 2).
 static bool hasHigherPrecedence(std::map<Value, int>& precedence, Value op1, Value op2) {
-    return precedence[op1] > precedence[op2];
+    if (op2 == Value(String(L"^"))) return precedence[op1] > precedence[op2];
+    return precedence[op1] >= precedence[op2];
+}
+
+static void expect(VM* vm, Type type) {
+    vm->need(1);
+    if (vm->top().index() != type) throw Error(Error::TYPE_MISMATCH, L"unexpected " + asString(vm->top()));
+}
+
+// Heap quota accounting, approximate: what containers hold, not what the allocator rounds it up to.
+static constexpr size_t EntryBytes = sizeof(Table::Entry) + 2 * sizeof(uint32_t);
+
+static void grew(VM* vm, const Table* tbl, size_t before) {
+    if (tbl->size() > before) vm->allocated((tbl->size() - before) * EntryBytes);
+}
+
+static Channel* channelOf(VM* vm) {
+    expect(vm, EXTERNAL);
+    auto* ch = dynamic_cast<Channel*>(std::get<EXTERNAL>(vm->top()));
+    if (ch == nullptr) throw Error(Error::TYPE_MISMATCH, L"not a channel: " + asString(vm->top()));
+    return ch;
+}
+
+// What a reference stands for, popped from the stack: a variable, a table entry, or a vector element still there.
+static Value* reference(VM* vm) {
+    vm->need(1);
+    Value ref = vm->pop();
+    if (ref.index() == VALUEPTR) return (Value*) std::get<VALUEPTR>(ref);                     // NOLINT
+    auto* element = ref.index() == EXTERNAL ? dynamic_cast<Element*>(std::get<EXTERNAL>(ref)) : nullptr;
+    if (element == nullptr) throw Error(Error::TYPE_MISMATCH, L"unexpected " + asString(ref));
+    if (Value* value = element->value(); value != nullptr) return value;
+    throw Error(Error::INVALID_ADDRESS, L"no vector element " + std::to_wstring(element->at()));
+}
+
+static TypedArray* typedArray(const Value& v) {
+    return v.index() == EXTERNAL ? dynamic_cast<TypedArray*>(std::get<EXTERNAL>(v)) : nullptr;
+}
+
+static std::vector<double> realsOf(TypedArray* arr) {
+    if (arr->kind() == TypedArray::FLOAT64) return { arr->reals(), arr->reals() + arr->size() };
+    return { arr->integers(), arr->integers() + arr->size() };
+}
+
+static TypedArray* newArray(VM* vm, TypedArray::Kind kind, size_t size) {
+    vm->allocated(sizeof(TypedArray) + size * sizeof(double));
+    return new TypedArray(kind, size);                                      // NOLINT
+}
+
+// Element-wise operators over typed arrays, a number on either side standing for every element. Outside a columnar
+// run the array on the left takes the result, as it always has; in one, an array may fill more than one stack slot
+// and the result is a new array.
+static bool vectorized(VM* vm, const Value& left, const Value& right, External::Operator op) {
+    TypedArray* l = typedArray(left);
+    TypedArray* r = typedArray(right);
+    if (l == nullptr && (r == nullptr || left.index() > REAL)) return false;
+    if (l == nullptr) {
+        l = newArray(vm, left.index() == REAL || r->kind() == TypedArray::FLOAT64 ? TypedArray::FLOAT64 : TypedArray::INT64, r->size());
+        l->fill(left);
+    } else if (vm->columnar()) {
+        vm->allocated(sizeof(TypedArray) + l->size() * sizeof(double));
+        std::vector<size_t> all(l->size());
+        for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+        l = l->gather(all);
+    }
+    l->operate(vm, op, right);
+    vm->push(static_cast<External*>(l));
+    return true;
+}
+
+// An exact integer on the stack: an Integer when it fits, a BigInt past that.
+static Value exactValue(VM* vm, const Big& big) {
+    if (big.fits()) return big.small();
+    vm->allocated(sizeof(BigInt) + big.bytes());
+    return static_cast<External*>(new BigInt(big));                         // NOLINT
+}
+
+static Value decimalValue(VM* vm, const Big& units, unsigned scale) {
+    vm->allocated(sizeof(Decimal) + units.bytes());
+    return static_cast<External*>(new Decimal(units, scale));                // NOLINT
+}
+
+// Integer arithmetic that carries on past the range of Integer as a BigInt rather than wrapping.
+static Value checked(VM* vm, Integer l, Integer r, External::Operator op) {
+    Integer x = 0;
+    switch (op) {
+    case External::ADD:      return addOverflows(l, r, x) ? exactValue(vm, Big(l) + Big(r)) : Value(x);
+    case External::SUBTRACT: return subtractOverflows(l, r, x) ? exactValue(vm, Big(l) - Big(r)) : Value(x);
+    case External::MULTIPLY: return multiplyOverflows(l, r, x) ? exactValue(vm, Big(l) * Big(r)) : Value(x);
+    default:                 return r == -1 ? exactValue(vm, -Big(l)) : Value(l / r);
+    }
+}
+
+static Value checked(VM*, Real l, Real r, External::Operator op) {
+    switch (op) {
+    case External::ADD:      return l + r;
+    case External::SUBTRACT: return l - r;
+    case External::MULTIPLY: return l * r;
+    default:                 return l / r;
+    }
+}
+
+// Whether an Integer holds x truncated: it is finite and within the range of Integer.
+static bool whole(Real x) {
+    return x >= Real(std::numeric_limits<Integer>::min()) && x < -Real(std::numeric_limits<Integer>::min());
+}
+
+// x rounded to the nearest Integer, as an Integer operand with a Real one gives, or x itself where no Integer holds it.
+static Value nearest(Real x) {
+    return whole(x + Half) ? Value(Integer(x + Half)) : Value(x);
+}
+
+// Arithmetic and comparison when either operand is a BigInt or a Decimal and the other a number. Integers, BigInts and
+// Decimals give exact results, a Decimal if either was one; a Real on either side makes it Real arithmetic. Returns
+// false, leaving the operands to the builtin, otherwise.
+static bool exact(VM* vm, const Value& left, const Value& right, External::Operator op) {
+    struct Number {
+             Big units;
+        unsigned scale = 0;
+            bool decimal = false;
+            bool ok = true;
+    };
+    auto numberOf = [](const Value& v) {
+        Number n;
+        if (v.index() == INTEGER) n.units = std::get<INTEGER>(v);
+        else if (auto* big = v.index() == EXTERNAL ? dynamic_cast<BigInt*>(std::get<EXTERNAL>(v)) : nullptr; big) n.units = big->value();
+        else if (auto* dec = v.index() == EXTERNAL ? dynamic_cast<Decimal*>(std::get<EXTERNAL>(v)) : nullptr; dec) {
+            n.units = dec->units();
+            n.scale = dec->scale();
+            n.decimal = true;
+        } else n.ok = false;
+        return n;
+    };
+    Number l = numberOf(left);
+    Number r = numberOf(right);
+    bool exactLeft = l.ok && left.index() == EXTERNAL, exactRight = r.ok && right.index() == EXTERNAL;
+    if (!exactLeft && !exactRight) return false;
+
+    if (op == External::POWER || (exactLeft ? right.index() == REAL : left.index() == REAL)) {
+        // asReal goes through toInteger for an External, which would saturate a BigInt and drop a Decimal's fraction.
+        auto real = [](const Value& v) { return v.index() == EXTERNAL ? std::get<EXTERNAL>(v)->toReal() : asReal(v); };
+        Real a = real(left), b = real(right);
+        switch (op) {
+        case External::ADD:           vm->push(a + b);                break;
+        case External::SUBTRACT:      vm->push(a - b);                break;
+        case External::MULTIPLY:      vm->push(a * b);                break;
+        case External::DIVIDE:        vm->push(a / b);                break;
+        case External::MODULO:        vm->push(std::fmod(a, b));      break;
+        case External::POWER:         vm->push(std::pow(a, b));       break;
+        case External::LESS:          vm->push(a < b);                break;
+        case External::LESS_EQUAL:    vm->push(a <= b);               break;
+        case External::GREATER:       vm->push(a > b);                break;
+        case External::GREATER_EQUAL: vm->push(a >= b);               break;
+        case External::EQUAL:         vm->push(a == b);               break;
+        case External::NOT_EQUAL:     vm->push(a != b);               break;
+        default:                      return false;
+        }
+        return true;
+    }
+    if (!l.ok || !r.ok) return false;
+
+    unsigned scale = std::max(l.scale, r.scale);
+    Big a = Decimal::rescale(l.units, l.scale, scale);
+    Big b = Decimal::rescale(r.units, r.scale, scale);
+    Big result;
+    switch (op) {
+    case External::ADD:      result = a + b;                                              break;
+    case External::SUBTRACT: result = a - b;                                              break;
+    case External::MULTIPLY: result = Decimal::rescale(a * b, 2 * scale, scale);          break;
+    case External::DIVIDE:
+        if (b.zero()) throw Error(Error::DIVIDE_BY_ZERO, L"division by zero");
+        result = l.decimal || r.decimal ? Decimal::round(a * Big::pow10(scale), b) : Big::divide(a, b);
+        break;
+    case External::MODULO:
+        if (b.zero()) throw Error(Error::DIVIDE_BY_ZERO, L"division by zero");
+        Big::divide(a, b, &result);
+        break;
+    case External::LESS:          vm->push(a.compare(b) < 0);  return true;
+    case External::LESS_EQUAL:    vm->push(a.compare(b) <= 0); return true;
+    case External::GREATER:       vm->push(a.compare(b) > 0);  return true;
+    case External::GREATER_EQUAL: vm->push(a.compare(b) >= 0); return true;
+    case External::EQUAL:         vm->push(a.compare(b) == 0); return true;
+    case External::NOT_EQUAL:     vm->push(a.compare(b) != 0); return true;
+    default:                      return false;
+    }
+    vm->push(l.decimal || r.decimal ? decimalValue(vm, result, scale) : exactValue(vm, result));
+    return true;
+}
+
+// A value found on a stack or in a frame when a columnar branch splits the rows: columns are cut down to the rows
+// selected, anything else goes as it is.
+static Value cut(VM* vm, const Value& v, size_t rows, const std::vector<size_t>& selected) {
+    TypedArray* a = typedArray(v);
+    if (a == nullptr || a->size() != rows) return v;
+    vm->allocated(sizeof(TypedArray) + selected.size() * sizeof(double));
+    return static_cast<External*>(a->gather(selected));
+}
+
+// The value both selections of a columnar branch left in the same slot, put back together row by row. A number or
+// anything else both left alike stays as it is; numbers that differ, or a column, make a column of every row.
+static Value merged(VM* vm, const std::array<std::vector<size_t>, 2>& selected, size_t rows, const std::array<Value, 2>& values) {
+    std::array<TypedArray*, 2> parts{};
+    bool real = false;
+    for (size_t way = 0; way < 2; ++way) {
+        parts[way] = typedArray(values[way]);
+        if (parts[way] != nullptr && parts[way]->size() != selected[way].size()) parts[way] = nullptr;
+        real |= parts[way] != nullptr ? parts[way]->kind() == TypedArray::FLOAT64 : values[way].index() == REAL;
+    }
+    if (parts[0] == nullptr && parts[1] == nullptr && values[0] == values[1]) return values[0];
+    for (size_t way = 0; way < 2; ++way) {
+        if (parts[way] == nullptr && values[way].index() > REAL) throw Error(Error::TYPE_MISMATCH, L"rows of a column differ in type: " + asString(values[way]));
+    }
+    TypedArray* column = newArray(vm, real ? TypedArray::FLOAT64 : TypedArray::INT64, rows);
+    for (size_t way = 0; way < 2; ++way) {
+        for (size_t k = 0; k < selected[way].size(); ++k) column->put(selected[way][k], parts[way] != nullptr ? parts[way]->at(k) : values[way]);
+    }
+    return static_cast<External*>(column);
 }
 
 void add(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::ADD) || exact(vm, left, right, External::ADD)) return;
 
     if (bool res = left.index() != right.index(); res) {
         switch (left.index()) {
-        case INTEGER:  vm->push(Integer(asReal(left) + asReal(right) + Half));          break;
+        case INTEGER:  vm->push(nearest(asReal(left) + asReal(right)));                 break;
         case REAL:     vm->push(asReal(left) + asReal(right));                          break;
         case STRING:   vm->push(std::get<STRING>(left) + asString(right));              break;
-        case TABLE:    (*std::get<TABLE>(left))[right] = 0; vm->push(left);             break;
-        case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"+", right); vm->push(left); break;
+        case TABLE: {
+                Table* tbl = std::get<TABLE>(left);
+                size_t before = tbl->size();
+                (*tbl)[right] = 0;
+                grew(vm, tbl, before);
+                vm->push(left);
+            }
+            break;
+        case VECTOR:   vm->allocated(sizeof(Value)); std::get<VECTOR>(left)->append(right); vm->push(left); break;
+        case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::ADD, right); vm->push(left); break;
         case VALUEPTR:
             if (right.index() > REAL) vm->push(left);
             else {
@@ -83,11 +392,21 @@ void add(VM* vm) {
         return;
     }
     switch (left.index()) {
-    case INTEGER:  vm->push(std::get<INTEGER>(left) + std::get<INTEGER>(right));     break;
+    case INTEGER:  vm->push(checked(vm, std::get<INTEGER>(left), std::get<INTEGER>(right), External::ADD)); break;
     case REAL:     vm->push(std::get<REAL>(left) + std::get<REAL>(right));           break;
     case STRING:   vm->push(std::get<STRING>(left) + std::get<STRING>(right));       break;
-    case TABLE:    vm->push(std::get<TABLE>(left)->append(std::get<TABLE>(right)));  break;
-    case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"+", right); vm->push(left);  break;
+    case TABLE: {
+            Table* tbl = std::get<TABLE>(left);
+            size_t before = tbl->size();
+            vm->push(tbl->append(std::get<TABLE>(right)));
+            grew(vm, tbl, before);
+        }
+        break;
+    case VECTOR:
+        vm->allocated(std::get<VECTOR>(right)->size() * sizeof(Value));
+        vm->push(std::get<VECTOR>(left)->append(std::get<VECTOR>(right)));
+        break;
+    case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::ADD, right); vm->push(left);  break;
     case VALUEPTR: vm->push(left);                                                   break;
     }
 }
@@ -102,20 +421,27 @@ void array(VM* vm) {
                 if (Value value = val.value(); value.index() == INTEGER) {
                     auto size = std::get<Integer>(value);
                     if (vm->compiling()) {
-                        vm->code()->locals()[name] = { 0 };
-                        vm->code()->locals()[name].resize(size);
-                        vm->code()->reverse()[vm->code()->locals()[name].data()] = name;
+                        vm->code()->declare(name, size_t(std::max(size, Integer(1))));
                         return;
                     }
-                    vm->globals()[name] = { 0 };
-                    vm->globals()[name].resize(size);
-                    vm->reverse()[vm->globals()[name].data()] = name;
+                    vm->declare(name, size_t(std::max(size, Integer(1))));
                 }
             }
         }
     }
 }
 
+void at(VM* vm) {
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+    if (left.index() != VECTOR || right.index() > REAL) {
+        vm->push(left);
+        return;
+    }
+    vm->push(std::get<VECTOR>(left)->at(asInteger(right)));
+}
+
 void algebra(VM* vm) {
     if (vm->precedence().empty()) {
         constexpr int BOOL = 10;
@@ -144,60 +470,62 @@ void algebra(VM* vm) {
         vm->precedence()[L"^"]    = POW;
         vm->precedence()[L"[*]"]  = REF;
     }
+    std::vector<std::unique_ptr<Expr>> tree;
+    auto operand = [&](const Value& v) {
+        if (!vm->compiling()) vm->push(v);
+        else {
+            if (v.index() == STRING) {
+                const String& name = std::get<STRING>(v);
+                vm->referred().insert(name[0] == '*' ? name.substr(1) : name);
+            }
+            tree.push_back(std::make_unique<Expr>(v));
+        }
+    };
     vm->syspush(L"[");
 
     for (auto tkn = vm->word(true); tkn.has_value(); tkn = vm->word()) {
         vm->pop();
         Value token = tkn.value();
-        if (token.index() == INTEGER || token.index() == REAL) vm->push(token);
+        if (token.index() == INTEGER || token.index() == REAL) operand(token);
         else {
             if (token.index() == STRING) {
                 String op = std::get<String>(token);
                 if (op == L"(") vm->syspush(token);
                 else if (op == L")") {
-                    Value systop = vm->systop();
-                    String top = std::get<String>(systop);
+                    String top = pending(vm);
                     while (!(top == L"[" || top == L"(")) {
-                        applyOperator(vm, systop);
+                        applyOperator(vm, top, tree);
                         vm->syspop();
-                        systop = vm->systop();
-                        top = std::get<String>(systop);
+                        top = pending(vm);
                     }
                     if (top == L"[") break;
                     vm->syspop(); // Remove '(' or '['
                 } else if (vm->precedence().contains(token)){
-                    Value systop = vm->systop();
-                    String top = std::get<String>(systop);
-                    while (top != L"[" && hasHigherPrecedence(vm->precedence(), systop, token)) {
-                        applyOperator(vm, systop);
+                    String top = pending(vm);
+                    while (top != L"[" && hasHigherPrecedence(vm->precedence(), top, token)) {
+                        applyOperator(vm, top, tree);
                         vm->syspop();
-                        systop = vm->systop();
-                        top = std::get<String>(systop);
+                        top = pending(vm);
                     }
                     vm->syspush(token);
                 } else {
                     String var = std::get<STRING>(token);
                     if (var[0] == '*') {
                         var = var.substr(1);
-                        if (vm->globals().contains(var)) {
-                            if (vm->compiling()) vm->push((Value*) vm->globals()[var].data());
-                            else vm->push(*(vm->globals()[var].data()));
-                        } else if (vm->code()->locals().contains(var)) {
-                            if (vm->compiling()) vm->push((Value*) vm->code()->locals()[var].data());
-                            else vm->push(*(vm->code()->locals()[var].data()));
-                        }
+                        if (vm->compiling() && isVariable(vm, vm->code(), var)) operand(token);
+                        else if (size_t g = vm->globalOf(var); g != VM::npos) operand(*vm->global(g));
                     } else {
-                        if (vm->globals().contains(var)) vm->push(vm->globals()[var].data());
-                        else if (vm->code()->locals().contains(var)) vm->push(vm->code()->locals()[var].data());
-                        else vm->push(token);
+                        if (vm->compiling()) operand(token);
+                        else if (size_t g = vm->globalOf(var); g != VM::npos) operand((void*) vm->global(g));
+                        else operand(token);
                     }
                 }
-            } else vm->push(token);
+            } else operand(token);
         }
     }
-    while (asString(vm->systop()) != L"[") applyOperator(vm, vm->syspop());
+    while (pending(vm) != L"[") applyOperator(vm, vm->syspop(), tree);
     vm->syspop();
-    if (vm->compiling()) vm->pop();
+    if (vm->compiling()) for (const auto& expr: tree) emit(vm, dynamic_cast<Compiled*>(vm->code()), *expr);
 }
 
 //
@@ -205,6 +533,25 @@ void algebra(VM* vm) {
 //    syspop                          [ (var) ]              [ ]                  [ ]
 //    syspush 1                       [ (var) 1 ]            [ ]                  [ ]
 //
+// Makes an exact integer of a number or a string of digits, dropping any fraction.
+void bigint(VM* vm) {
+    vm->need(1);
+    Value v = vm->pop();
+    External* x = v.index() == EXTERNAL ? std::get<EXTERNAL>(v) : nullptr;
+    switch (v.index()) {
+    case INTEGER: vm->push(v);                                                  break;
+    case REAL:    vm->push(exactValue(vm, Big::fromReal(std::get<REAL>(v))));  break;
+    case STRING:
+        if (auto parsed = Big::parse(std::get<STRING>(v)); parsed.has_value()) vm->push(exactValue(vm, *parsed));
+        else throw Error(Error::BAD_NUMBER, L"not a number: " + std::get<STRING>(v));
+        break;
+    default:
+        if (dynamic_cast<BigInt*>(x) != nullptr) vm->push(v);
+        else if (auto* d = dynamic_cast<Decimal*>(x); d != nullptr) vm->push(exactValue(vm, Big::divide(d->units(), Big::pow10(d->scale()))));
+        else throw Error(Error::TYPE_MISMATCH, L"not a number: " + asString(v));
+    }
+}
+
 void by(VM* vm) {
     if (!vm->compiling()) return;
 
@@ -214,13 +561,64 @@ void by(VM* vm) {
     vm->syspush(0);
 }
 
+void channel(VM* vm) {
+    vm->need(1);
+    Integer capacity = asInteger(vm->pop());
+    vm->allocated(sizeof(Channel));
+    vm->push(static_cast<External*>(new Channel(size_t(std::max(capacity, Integer(1))))));   // NOLINT
+}
+
+void compare(VM* vm) {
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+
+    if (left.index() != STRING || right.index() != STRING) {
+        vm->push(Integer(left < right ? -1 : (right < left ? 1 : 0)));
+        return;
+    }
+    const String& l = std::get<STRING>(left);
+    const String& r = std::get<STRING>(right);
+    size_t common = std::min(l.size(), r.size());
+    if (size_t at = Simd::mismatch(l.data(), r.data(), common); at != Simd::npos) vm->push(Integer(l[at] < r[at] ? -1 : 1));
+    else vm->push(Integer(l.size() < r.size() ? -1 : (l.size() > r.size() ? 1 : 0)));
+}
+
+void concat(VM* vm) {
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+    if (left.index() != VECTOR || right.index() != VECTOR) {
+        vm->push(left);
+        return;
+    }
+    Vector* vec = std::get<VECTOR>(left);
+    vm->allocated(sizeof(Vector) + (vec->size() + std::get<VECTOR>(right)->size()) * sizeof(Value));
+    Vector* res = new Vector();                                             // NOLINT
+    res->reserve(vec->size() + std::get<VECTOR>(right)->size());
+    vm->push(res->append(vec)->append(std::get<VECTOR>(right)));
+}
+
+void contains(VM* vm) {
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+
+    if (left.index() != STRING || right.index() != STRING) {
+        vm->push(0);
+        return;
+    }
+    const String& l = std::get<STRING>(left);
+    const String& r = std::get<STRING>(right);
+    vm->push(Simd::find(l.data(), l.size(), r.data(), r.size()) != Simd::npos);
+}
+
 void dbg(VM* vm) {
     if (auto val = vm->word(true); val.has_value()) {
         vm->pop();
         if (vm->compiling()) return;
         if (Value value = val.value(); value.index() == STRING) {
             auto& dict = vm->dictionary();
-            auto& globals = vm->globals();
             auto name = std::get<String>(value);
             if (dict.contains(name)) {
                 if (auto* block = dynamic_cast<Compiled*>(dict[name]); block) {
@@ -233,10 +631,17 @@ void dbg(VM* vm) {
                         case Compiled::POP:     cstd::out.putString(L"POP\r\n");                                                 break;
                         case Compiled::SYSPOP:  cstd::out.putString(L"SYSPOP\r\n");                                              break;
                         case Compiled::RETURN:  cstd::out.putString(L"RETURN\r\n");                                              break;
-                        case Compiled::PUSH:    cstd::out.putString(L"PUSH " + toString(vm, block, instr.value()) + L"\r\n");    break;
-                        case Compiled::SYSPUSH: cstd::out.putString(L"SYSPUSH " + toString(vm, block, instr.value()) + L"\r\n"); break;
+                        case Compiled::PUSH:    cstd::out.putString(L"PUSH " + toString(vm, instr.value()) + L"\r\n");    break;
+                        case Compiled::SYSPUSH: cstd::out.putString(L"SYSPUSH " + toString(vm, instr.value()) + L"\r\n"); break;
                         case Compiled::JUMP:    cstd::out.putString(L"JUMP " + asString(instr.by()) + L"\r\n");                  break;
                         case Compiled::BRANCH:  cstd::out.putString(L"BRANCH " + asString(instr.by()) + L"\r\n");                break;
+                        case Compiled::LOCAL:   cstd::out.putString(L"LOCAL " + block->localAt(instr.by()) + L"\r\n");         break;
+                        case Compiled::GLOBAL:  cstd::out.putString(L"GLOBAL " + vm->globals()[instr.by()].name + L"\r\n");    break;
+                        case Compiled::TRY:     cstd::out.putString(L"TRY " + asString(instr.by()) + L"\r\n");                   break;
+                        case Compiled::ENDTRY:  cstd::out.putString(L"ENDTRY " + asString(instr.by()) + L"\r\n");                break;
+                        case Compiled::INTEGER_OP: cstd::out.putString(L"INTEGER " + Compiled::symbol(instr.by()) + L"\r\n");   break;
+                        case Compiled::REAL_OP:    cstd::out.putString(L"REAL " + Compiled::symbol(instr.by()) + L"\r\n");      break;
+                        case Compiled::GUARDED_OP: cstd::out.putString(L"GUARDED " + Compiled::symbol(instr.by()) + L"\r\n");   break;
                         case Compiled::CALL:
                             auto* code = instr.code();
                             String out = L"<unknown>";
@@ -246,69 +651,134 @@ void dbg(VM* vm) {
                         }
                     }
                 } else cstd::out.putString(name + L": builtin\r\n");
-            } else if (globals.contains(name)) cstd::out.putString(name + L": " + asString((void*) globals[name].data()) + L"\r\n"); // NOLINT
+            } else if (size_t g = vm->globalOf(name); g != VM::npos) cstd::out.putString(name + L": " + asString(*vm->global(g)) + L"\r\n");
             else cstd::out.putString(asString(value) + L"\r\n");
         } else cstd::out.putString(asString(value) + L"\r\n");
     }
 }
 
+// Compiles a reference to code: runs it now if it is immediate, copies it in if it is short, calls it otherwise.
+// Returns whether it was copied.
+static bool compileReference(VM* vm, Compiled* block, Code* code) {
+    if (code->immediate()) code->exec(vm);
+    else if (code->compiled() && static_cast<Compiled*>(code)->inlinable()) {
+        block->append(*static_cast<Compiled*>(code));
+        return true;
+    } else block->call(code);
+    return false;
+}
+
+// Compiles what the buffer holds up to end as the body of name. Short words it calls are copied in rather than called.
+// The names it refers to, defined yet or not and in algebra too, are recorded so that redefining them can compile this
+// one again. Inside its own body name means earlier, the definition being replaced as it stands, so a word can be
+// redefined in terms of what it was; with no earlier definition it is a recursive call, to self when the word is being
+// compiled again.
+// Returns nullptr if the buffer runs out first.
+static Compiled* compileWord(VM* vm, const String& name, Compiled* self = nullptr, Code* earlier = nullptr) {
+    auto& dict = vm->dictionary();
+    auto block = new Compiled();                                          // NOLINT
+    Code* save = vm->code();
+    vm->code(block);
+    std::set<String> uses, copies;
+    std::set<String> outer = std::exchange(vm->referred(), {});
+    bool older = false;
+    for (; ; ) {
+        auto val = vm->word();
+        if (!val.has_value()) {
+            delete block;                                                 // NOLINT
+            block = nullptr;
+            break;
+        }
+        Value value = val.value();
+        vm->pop();
+
+        if (value.index() == STRING) {
+            if (String word = std::get<String>(value); word == L"end") {
+                block->ret();
+                break;
+            } else if (String word = std::get<String>(value); word == L"return") block->ret();
+            else if (word == name && earlier == nullptr) block->call(self ? self : block);
+            else if (word == name) {
+                // The word being replaced takes the new body, so the old one has to live on in a word of its own.
+                if (earlier == self) earlier = self->copy();
+                compileReference(vm, block, earlier);
+                older = true;
+            } else if (uses.insert(word); dict.contains(word)) {
+                if (compileReference(vm, block, dict[word])) copies.insert(word);
+            } else compileVariable(vm, block, value);
+        } else block->push(value);
+    }
+    vm->code(save);
+    uses.merge(std::exchange(vm->referred(), std::move(outer)));
+    if (block) {
+        vm->depends(name, uses, copies);
+        vm->earlier(name, older ? earlier : nullptr);
+        block->simplify(vm);
+        block->specialize(vm);
+    }
+    return block;
+}
+
+// x scale decimal: x as a fixed point number with scale digits after the point, rounded half away from zero.
+void decimal(VM* vm) {
+    vm->need(2);
+    Integer scale = asInteger(vm->pop());
+    Value v = vm->pop();
+    if (scale < 0 || scale > Integer(Decimal::MaxScale)) throw Error(Error::BAD_NUMBER, L"bad decimal scale: " + std::to_wstring(scale));
+    unsigned to = unsigned(scale);
+    External* x = v.index() == EXTERNAL ? std::get<EXTERNAL>(v) : nullptr;
+    Big units;
+    switch (v.index()) {
+    case INTEGER: units = Big(std::get<INTEGER>(v)) * Big::pow10(to);                            break;
+    case REAL:    units = Big::fromReal(std::round(std::get<REAL>(v) * Big::pow10(to).toReal()));  break;
+    case STRING: {
+            unsigned from = 0;
+            if (!Decimal::parse(std::get<STRING>(v), units, from)) throw Error(Error::BAD_NUMBER, L"not a number: " + std::get<STRING>(v));
+            units = Decimal::rescale(units, from, to);
+        }
+        break;
+    default:
+        if (auto* b = dynamic_cast<BigInt*>(x); b != nullptr) units = b->value() * Big::pow10(to);
+        else if (auto* d = dynamic_cast<Decimal*>(x); d != nullptr) units = Decimal::rescale(d->units(), d->scale(), to);
+        else throw Error(Error::TYPE_MISMATCH, L"not a number: " + asString(v));
+    }
+    vm->push(decimalValue(vm, units, to));
+}
+
 void def(VM* vm) {
     vm->compiling(true);
     if (auto val = vm->word(true); val.has_value()) {
         vm->pop();
         if (Value value = val.value(); value.index() == STRING) {
-            auto& dict = vm->dictionary();
-            auto& globals = vm->globals();
             auto name = std::get<String>(value);
-            auto block = new Compiled();                                  // NOLINT
-            Code* save = vm->code();
-            vm->code(block);
-            auto& locals = block->locals();
-            for (; ; ) {
-                val = vm->word();
-                if (!val.has_value()) {
-                    delete block;                                         // NOLINT
-                    block = nullptr;
-                    break;
-                }
-                value = val.value();
-                vm->pop();
-
-                if (value.index() == STRING) {
-                    if (String word = std::get<String>(value); word == L"end") {
-                        block->ret();
-                        break;
-                    } else if (String word = std::get<String>(value); word == L"return") block->ret();
-                    else if (dict.contains(word)) {
-                        Code* code = dict[word];
-                        if (code->immediate()) code->exec(vm);
-                        else block->call(dict[word]);
-                    } else if (globals.contains(word)) block->push((Value*) globals[word].data());
-                    else if (locals.contains(word)) block->push((Value*) locals[word].data());
-                    else block->push(value);
-                } else block->push(value);
-            }
-            if (block) {
-                vm->dictionary()[name] = block;
-                vm->nameOf(block, name);
-            }
-            vm->code(save);
+            String source = vm->buffer();
+            Code* earlier = vm->dictionary().contains(name) ? vm->dictionary()[name] : nullptr;
+            Compiled* self = vm->redefining(name);
+            Compiled* block = vm->cached(name);
+            if (block == nullptr) block = compileWord(vm, name, self, earlier);
+            if (block) vm->defined(name, source.substr(0, source.size() - vm->buffer().size()), block);
         }
     }
     vm->compiling(false);
 }
 
 void divide(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::DIVIDE) || exact(vm, left, right, External::DIVIDE)) return;
 
     if (bool res = left.index() != right.index(); res) {
         switch (left.index()) {
-        case INTEGER:  vm->push(Integer(asReal(left) / asReal(right) + Half));          break;
-        case REAL:     vm->push(asReal(left) / asReal(right));                          break;
-        case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"/", right); vm->push(left); break;
+        case INTEGER:
+        case REAL:
+            if (asReal(right) == 0) throw Error(Error::DIVIDE_BY_ZERO, L"division by zero");
+            if (left.index() == INTEGER) vm->push(nearest(asReal(left) / asReal(right)));
+            else vm->push(asReal(left) / asReal(right));
+            break;
+        case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::DIVIDE, right); vm->push(left); break;
         case TABLE:
+        case VECTOR:
         case VALUEPTR: vm->push(left);                                                  break;
         case STRING: {
                 switch (right.index()) {
@@ -352,10 +822,14 @@ void divide(VM* vm) {
         return;
     }
     switch (left.index()) {
-    case INTEGER:  vm->push(std::get<INTEGER>(left) / std::get<INTEGER>(right));    break;
+    case INTEGER:
+        if (std::get<INTEGER>(right) == 0) throw Error(Error::DIVIDE_BY_ZERO, L"division by zero");
+        vm->push(checked(vm, std::get<INTEGER>(left), std::get<INTEGER>(right), External::DIVIDE));
+        break;
     case REAL:     vm->push(std::get<REAL>(left) / std::get<REAL>(right));          break;
-    case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"/", right); vm->push(left); break;
+    case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::DIVIDE, right); vm->push(left); break;
     case TABLE:
+    case VECTOR:
     case VALUEPTR: vm->push(left);                                                  break;
     case STRING: {
             String str = get<STRING>(left);
@@ -376,6 +850,21 @@ void divide(VM* vm) {
     }
 }
 
+//
+//    $ (loc) = endtry 0              [ (try) ]              [ ]                  [ ]
+//    update try at (try) to (loc)    [ ]                    [ ]                  [ ]
+//    syspush (loc)                   [ (loc) ]              [ ]                  [ ]
+//
+void doCatch(VM* vm) {
+    if (!vm->compiling()) return;
+
+    Compiled* code = dynamic_cast<Compiled*>(vm->code());
+    Integer loc = Integer(code->endTry(0));
+    Integer prev = asInteger(vm->syspop());
+    code->update(int(prev), int(loc - prev));
+    vm->syspush(loc);
+}
+
 void doDo(VM* vm) {
     if (!vm->compiling()) return;
 
@@ -404,6 +893,15 @@ void doEndIf(VM* vm) {
     code->update(int(prev), int(loc - prev));
 }
 
+void doEndTry(VM* vm) {
+    if (!vm->compiling()) return;
+
+    Compiled* code = dynamic_cast<Compiled*>(vm->code());
+    Integer loc = Integer(code->location());
+    Integer prev = asInteger(vm->syspop());
+    code->update(int(prev), int(loc - prev));
+}
+
 //
 //                                    [ ]                    [ ]                  [ ]
 //    (var) = word                    [ ]                    [ ]                  [ ]
@@ -420,9 +918,8 @@ void doFor(VM* vm) {
         if (Value value = val.value(); value.index() == STRING) {
             auto name = std::get<String>(value);
             Compiled* code = dynamic_cast<Compiled*>(vm->code());
-            code->locals()[name] = { 0 };
-            code->reverse()[vm->code()->locals()[name].data()] = name;
-            vm->syspush((Value*) vm->code()->locals()[name].data());
+            code->declare(name);
+            vm->syspush(name);
             code->syspush(1);
             vm->syspush(1);
         }
@@ -436,6 +933,20 @@ void doReturn(VM* vm) {
     code->ret();
 }
 
+void doThrow(VM* vm) {
+    vm->need(2);
+    Integer code = asInteger(vm->pop());
+    Value message = vm->pop();
+    throw Error(code, message.index() == STRING ? std::get<STRING>(message) : asString(message));
+}
+
+void doTry(VM* vm) {
+    if (!vm->compiling()) return;
+
+    Compiled* code = dynamic_cast<Compiled*>(vm->code());
+    vm->syspush(Integer(code->tryBlock(0)));
+}
+
 void doWhile(VM* vm) {
     if (!vm->compiling()) return;
 
@@ -455,10 +966,40 @@ void done(VM* vm) {
     code->jump(int(start - location - 1));
 }
 
+void dot(VM* vm) {
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+
+    TypedArray* l = typedArray(left);
+    TypedArray* r = typedArray(right);
+    if (l == nullptr || r == nullptr || l->size() != r->size()) {
+        vm->push(0);
+        return;
+    }
+    if (l->kind() == TypedArray::INT64 && r->kind() == TypedArray::INT64) vm->push(Integer(Simd::dot(l->integers(), r->integers(), l->size())));
+    else vm->push(Real(Simd::dot(realsOf(l).data(), realsOf(r).data(), l->size())));
+}
+
+void endsWith(VM* vm) {
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+
+    if (left.index() != STRING || right.index() != STRING) {
+        vm->push(0);
+        return;
+    }
+    const String& l = std::get<STRING>(left);
+    const String& r = std::get<STRING>(right);
+    vm->push(r.size() <= l.size() && Simd::mismatch(l.data() + l.size() - r.size(), r.data(), r.size()) == Simd::npos);
+}
+
 void equal(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::EQUAL) || exact(vm, left, right, External::EQUAL)) return;
 
     if (bool res = left.index() != right.index(); res) {
         vm->push(!res);
@@ -469,13 +1010,14 @@ void equal(VM* vm) {
     case REAL:     vm->push(std::get<REAL>(left) == std::get<REAL>(right));         break;
     case STRING:   vm->push(std::get<STRING>(left) == std::get<STRING>(right));     break;
     case TABLE:    vm->push(std::get<TABLE>(left) == std::get<TABLE>(right));       break;
+    case VECTOR:   vm->push(std::get<VECTOR>(left) == std::get<VECTOR>(right));     break;
     case EXTERNAL: vm->push(std::get<EXTERNAL>(left) == std::get<EXTERNAL>(right)); break;
     case VALUEPTR: vm->push(std::get<VALUEPTR>(left) == std::get<VALUEPTR>(right)); break;
     }
 }
 
 void explode(VM* vm) {
-    if (vm->size() < 1) return;
+    vm->need(1);
     Value val = vm->top();
     if (val.index() != STRING) return;
     vm->pop();
@@ -489,70 +1031,154 @@ void explode(VM* vm) {
 }
 
 void fetch(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
 
+    if (TypedArray* arr = typedArray(left); arr) {
+        Integer at = asInteger(right);
+        vm->push(at >= 0 && size_t(at) < arr->size() ? arr->at(size_t(at)) : Value(0));
+        return;
+    }
+    if (left.index() == VECTOR) {
+        vm->push(std::get<VECTOR>(left)->at(asInteger(right)));
+        return;
+    }
     if (left.index() != TABLE) {
         vm->push(left);
         return;
     }
 
     Table& tbl = *std::get<TABLE>(left);
-    Value val = tbl[right];
-    vm->push(val);
+    Value* val = tbl.find(right);
+    vm->push(val != nullptr ? *val : Value(0));
 }
 
 
-void get(VM* vm) {
-    if (vm->empty()) return;
+void fill(VM* vm) {
+    vm->need(2);
     Value value = vm->pop();
-    if (value.index() != VALUEPTR) return;
-    Value* var = (Value*) std::get<void*>(value); // NOLINT
-    vm->push(*var);
+    Value arr = vm->top();
+    if (TypedArray* a = typedArray(arr); a) a->fill(value);
+}
+
+void first(VM* vm) {
+    expect(vm, TABLE);
+    Table::Entry* entry = std::get<TABLE>(vm->pop())->first();
+    vm->push(entry != nullptr ? entry->first : Value(0));
+    vm->push(entry != nullptr ? entry->second : Value(0));
+}
+
+void find(VM* vm) {
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+
+    if (left.index() != STRING || right.index() != STRING) {
+        vm->push(-1);
+        return;
+    }
+    const String& l = std::get<STRING>(left);
+    const String& r = std::get<STRING>(right);
+    size_t at = Simd::find(l.data(), l.size(), r.data(), r.size());
+    vm->push(at == Simd::npos ? Integer(-1) : Integer(at));
+}
+
+void floatArray(VM* vm) {
+    vm->need(1);
+    Integer size = std::max(asInteger(vm->pop()), Integer(0));
+    vm->allocated(sizeof(TypedArray) + size_t(size) * sizeof(double));
+    vm->push(static_cast<External*>(new TypedArray(TypedArray::FLOAT64, size_t(size)))); // NOLINT
+}
+
+void get(VM* vm) {
+    vm->push(*reference(vm));
 }
 
 void greater(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::GREATER) || exact(vm, left, right, External::GREATER)) return;
 
     if (bool res = left.index() != right.index(); res) {
-        vm->push(!res);
+        if (left.index() == EXTERNAL) std::get<EXTERNAL>(left)->operate(vm, External::GREATER, right);
+        vm->push(left.index() == EXTERNAL ? left : Value(!res));
         return;
     }
     switch (left.index()) {
     case INTEGER:  vm->push(std::get<INTEGER>(left) > std::get<INTEGER>(right));               break;
     case REAL:     vm->push(std::get<REAL>(left) > std::get<REAL>(right));                     break;
     case STRING:   vm->push(std::get<STRING>(left) > std::get<STRING>(right));                 break;
-    case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L">", right); vm->push(left);            break;
+    case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::GREATER, right); vm->push(left);            break;
     case TABLE:    vm->push(std::get<TABLE>(left)->size() > std::get<TABLE>(right)->size());   break;
+    case VECTOR:   vm->push(std::get<VECTOR>(left)->size() > std::get<VECTOR>(right)->size()); break;
     case VALUEPTR: vm->push(std::get<VALUEPTR>(left) > std::get<VALUEPTR>(right));             break;
     }
 }
 
 void greaterEqual(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::GREATER_EQUAL) || exact(vm, left, right, External::GREATER_EQUAL)) return;
 
     if (bool res = left.index() != right.index(); res) {
-        vm->push(!res);
+        if (left.index() == EXTERNAL) std::get<EXTERNAL>(left)->operate(vm, External::GREATER_EQUAL, right);
+        vm->push(left.index() == EXTERNAL ? left : Value(!res));
         return;
     }
     switch (left.index()) {
     case INTEGER:  vm->push(std::get<INTEGER>(left) >= std::get<INTEGER>(right));               break;
     case REAL:     vm->push(std::get<REAL>(left) >= std::get<REAL>(right));                     break;
     case STRING:   vm->push(std::get<STRING>(left) >= std::get<STRING>(right));                 break;
-    case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L">=", right); vm->push(left);            break;
+    case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::GREATER_EQUAL, right); vm->push(left);            break;
     case TABLE:    vm->push(std::get<TABLE>(left)->size() >= std::get<TABLE>(right)->size());   break;
+    case VECTOR:   vm->push(std::get<VECTOR>(left)->size() >= std::get<VECTOR>(right)->size()); break;
     case VALUEPTR: vm->push(std::get<VALUEPTR>(left) >= std::get<VALUEPTR>(right));             break;
     }
 }
 
+void intArray(VM* vm) {
+    vm->need(1);
+    Integer size = std::max(asInteger(vm->pop()), Integer(0));
+    vm->allocated(sizeof(TypedArray) + size_t(size) * sizeof(long long));
+    vm->push(static_cast<External*>(new TypedArray(TypedArray::INT64, size_t(size))));   // NOLINT
+}
+
+void join(VM* vm) {
+    vm->join();
+}
+
+void keys(VM* vm) {
+    expect(vm, TABLE);
+    Table* tbl = std::get<TABLE>(vm->pop());
+    for (const auto& entry: *tbl) vm->push(entry.first);
+    vm->push(Integer(tbl->size()));
+}
+
+void last(VM* vm) {
+    expect(vm, TABLE);
+    Table::Entry* entry = std::get<TABLE>(vm->pop())->last();
+    vm->push(entry != nullptr ? entry->first : Value(0));
+    vm->push(entry != nullptr ? entry->second : Value(0));
+}
+
 void len(VM* vm) {
-    if (vm->size() < 1) return;
+    vm->need(1);
     Value val = vm->pop();
+    if (TypedArray* arr = typedArray(val); arr) {
+        vm->push(Integer(arr->size()));
+        return;
+    }
+    if (val.index() == TABLE) {
+        vm->push(Integer(std::get<TABLE>(val)->size()));
+        return;
+    }
+    if (val.index() == VECTOR) {
+        vm->push(Integer(std::get<VECTOR>(val)->size()));
+        return;
+    }
     if (val.index() != STRING) {
         vm->push(0);
         return;
@@ -562,95 +1188,185 @@ void len(VM* vm) {
 }
 
 void less(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::LESS) || exact(vm, left, right, External::LESS)) return;
 
     if (bool res = left.index() != right.index(); res) {
-        vm->push(!res);
+        if (left.index() == EXTERNAL) std::get<EXTERNAL>(left)->operate(vm, External::LESS, right);
+        vm->push(left.index() == EXTERNAL ? left : Value(!res));
         return;
     }
     switch (left.index()) {
     case INTEGER:  vm->push(std::get<INTEGER>(left) < std::get<INTEGER>(right));               break;
     case REAL:     vm->push(std::get<REAL>(left) < std::get<REAL>(right));                     break;
     case STRING:   vm->push(std::get<STRING>(left) < std::get<STRING>(right));                 break;
-    case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"<", right); vm->push(left);            break;
+    case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::LESS, right); vm->push(left);            break;
     case TABLE:    vm->push(std::get<TABLE>(left)->size() < std::get<TABLE>(right)->size());   break;
+    case VECTOR:   vm->push(std::get<VECTOR>(left)->size() < std::get<VECTOR>(right)->size()); break;
     case VALUEPTR: vm->push(std::get<VALUEPTR>(left) < std::get<VALUEPTR>(right));             break;
     }
 }
 
 void lessEqual(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::LESS_EQUAL) || exact(vm, left, right, External::LESS_EQUAL)) return;
 
     if (bool res = left.index() != right.index(); res) {
-        vm->push(!res);
+        if (left.index() == EXTERNAL) std::get<EXTERNAL>(left)->operate(vm, External::LESS_EQUAL, right);
+        vm->push(left.index() == EXTERNAL ? left : Value(!res));
         return;
     }
     switch (left.index()) {
     case INTEGER:  vm->push(std::get<INTEGER>(left) <= std::get<INTEGER>(right));               break;
     case REAL:     vm->push(std::get<REAL>(left) <= std::get<REAL>(right));                     break;
     case STRING:   vm->push(std::get<STRING>(left) <= std::get<STRING>(right));                 break;
-    case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"<=", right); vm->push(left);            break;
+    case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::LESS_EQUAL, right); vm->push(left);            break;
     case TABLE:    vm->push(std::get<TABLE>(left)->size() <= std::get<TABLE>(right)->size());   break;
+    case VECTOR:   vm->push(std::get<VECTOR>(left)->size() <= std::get<VECTOR>(right)->size()); break;
     case VALUEPTR: vm->push(std::get<VALUEPTR>(left) <= std::get<VALUEPTR>(right));             break;
     }
 }
 
 void index(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
 
+    if (left.index() == VECTOR) {
+        Vector& vec = *std::get<VECTOR>(left);
+        Integer at = asInteger(right);
+        if (at >= 0 && size_t(at) < vec.size()) {
+            vm->allocated(sizeof(Element));
+            vm->push(static_cast<External*>(new Element(&vec, at)));     // NOLINT
+        } else vm->push(left);
+        return;
+    }
     if (left.index() != TABLE) {
         vm->push(left);
         return;
     }
 
     Table& tbl = *std::get<TABLE>(left);
+    size_t before = tbl.size();
     Value* ptr = &tbl[right];
+    grew(vm, &tbl, before);
     vm->push((void*)(ptr));
 }
 
-void modulo(VM* vm) {
-    if (vm->size() < 2) return;
-    Value right = vm->pop();
-    Value left = vm->pop();
+void lower(VM* vm) {
+    vm->need(1);
+    Value val = vm->pop();
+    if (val.index() == STRING) {
+        String& str = std::get<STRING>(val);
+        Simd::lower(str.data(), str.size());
+    }
+    vm->push(val);
+}
 
-    if (bool res = left.index() != right.index(); res) {
-        switch (left.index()) {
-        case INTEGER:                                                                                   break;
-        case REAL:     vm->push(asInteger(right) ? abs(long(asInteger(left) % asInteger(right))) : -1); break; // NOLINT
-        case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"%", right); vm->push(left);                 break;
-        case VALUEPTR:
-        case TABLE:
-        case STRING:   vm->push(left);                                                                  break;
-        }
+void maximum(VM* vm) {
+    vm->need(1);
+    if (TypedArray* a = typedArray(vm->top()); a) {
+        vm->pop();
+        if (a->kind() == TypedArray::INT64) vm->push(Integer(Simd::max(a->integers(), a->size())));
+        else vm->push(Real(Simd::max(a->reals(), a->size())));
         return;
     }
-    switch (left.index()) {
-    case INTEGER:
-    case REAL:     vm->push(asInteger(left) % asInteger(right));                    break;
-    case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"%", right); vm->push(left); break;
-    case VALUEPTR:
-    case TABLE:
-    case STRING:   vm->push(left);                                                  break;
-    }
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+    if (left.index() <= REAL && right.index() <= REAL) vm->push(asReal(left) < asReal(right) ? right : left);
+    else vm->push(left < right ? right : left);
+}
+
+void minimum(VM* vm) {
+    vm->need(1);
+    if (TypedArray* a = typedArray(vm->top()); a) {
+        vm->pop();
+        if (a->kind() == TypedArray::INT64) vm->push(Integer(Simd::min(a->integers(), a->size())));
+        else vm->push(Real(Simd::min(a->reals(), a->size())));
+        return;
+    }
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+    if (left.index() <= REAL && right.index() <= REAL) vm->push(asReal(right) < asReal(left) ? right : left);
+    else vm->push(right < left ? right : left);
+}
+
+// l % r for r other than 0. The remainder of the most negative Integer over -1 traps like the quotient would; it is 0.
+static Integer remainderOf(Integer l, Integer r) {
+    return r == -1 ? 0 : l % r;
+}
+
+// Whether r is 0 once truncated to an Integer, as the remainder takes it.
+static bool zeroDivisor(const Value& r) {
+    Real y = asReal(r);
+    return y == 0 || (whole(y) && asInteger(r) == 0);
+}
+
+// l % r for numbers, r not 0. A Real no Integer holds, infinite or not a number, takes the remainder as Reals instead.
+static Value remainderOf(const Value& l, const Value& r) {
+    Real x = asReal(l);
+    Real y = asReal(r);
+    if ((l.index() == REAL && !whole(x)) || (r.index() == REAL && !whole(y))) return std::fmod(x, y);
+    return remainderOf(asInteger(l), asInteger(r));
+}
+
+void modulo(VM* vm) {
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+    if (vectorized(vm, left, right, External::MODULO) || exact(vm, left, right, External::MODULO)) return;
+
+    if (bool res = left.index() != right.index(); res) {
+        switch (left.index()) {
+        case INTEGER:
+        case REAL: {
+                if (zeroDivisor(right)) throw Error(Error::DIVIDE_BY_ZERO, L"division by zero");
+                Value rest = remainderOf(left, right);
+                if (rest.index() == INTEGER) vm->push(abs(long(std::get<INTEGER>(rest)))); // NOLINT
+                else vm->push(std::abs(std::get<REAL>(rest)));
+            }
+            break;
+        case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::MODULO, right); vm->push(left);                 break;
+        case VALUEPTR:
+        case TABLE:
+        case VECTOR:
+        case STRING:   vm->push(left);                                                                  break;
+        }
+        return;
+    }
+    switch (left.index()) {
+    case INTEGER:
+    case REAL:
+        if (zeroDivisor(right)) throw Error(Error::DIVIDE_BY_ZERO, L"division by zero");
+        vm->push(remainderOf(left, right));
+        break;
+    case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::MODULO, right); vm->push(left); break;
+    case VALUEPTR:
+    case TABLE:
+    case VECTOR:
+    case STRING:   vm->push(left);                                                  break;
+    }
 }
 
 void multiply(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::MULTIPLY) || exact(vm, left, right, External::MULTIPLY)) return;
 
     if (bool res = left.index() != right.index(); res) {
         switch (left.index()) {
-        case INTEGER:  vm->push(Integer(asReal(left) * asReal(right) + Half));          break;
+        case INTEGER:  vm->push(nearest(asReal(left) * asReal(right)));                 break;
         case REAL:     vm->push(asReal(left) * asReal(right));                          break;
-        case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"*", right); vm->push(left); break;
+        case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::MULTIPLY, right); vm->push(left); break;
         case TABLE:
+        case VECTOR:
         case VALUEPTR: vm->push(left);                                                  break;
         case STRING: {
                 switch (right.index()) {
@@ -658,6 +1374,7 @@ void multiply(VM* vm) {
                         String s;
                         Integer n = std::get<INTEGER>(right);
                         String l = std::get<String>(left);
+                        if (n > 0) vm->roomFor(size_t(n) * l.size() * sizeof(wchar_t));
                         for (auto i = 0; i < n; ++i) s += l;
                         vm->push(s);
                     }
@@ -667,6 +1384,7 @@ void multiply(VM* vm) {
                         Real r = std::get<REAL>(right);
                         Integer n = r;                       // NOLINT
                         String l = std::get<String>(left);
+                        if (n > 0) vm->roomFor(size_t(n + 1) * l.size() * sizeof(wchar_t));
                         for (auto i = 0; i < n; ++i) s += l;
                         n = l.size() * (r - n);              // NOLINT
                         s += l.substr(0, n);
@@ -681,11 +1399,12 @@ void multiply(VM* vm) {
         return;
     }
     switch (left.index()) {
-    case INTEGER:  vm->push(std::get<INTEGER>(left) * std::get<INTEGER>(right));    break;
+    case INTEGER:  vm->push(checked(vm, std::get<INTEGER>(left), std::get<INTEGER>(right), External::MULTIPLY)); break;
     case REAL:     vm->push(std::get<REAL>(left) * std::get<REAL>(right));          break;
-    case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"*", right); vm->push(left); break;
+    case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::MULTIPLY, right); vm->push(left); break;
     case STRING:
     case TABLE:
+    case VECTOR:
     case VALUEPTR: vm->push(left);                                                  break;
     }
 }
@@ -714,7 +1433,7 @@ void next(VM* vm) {
     Value loc = vm->syspop();
     Value var = vm->syspop();
     Compiled* code = dynamic_cast<Compiled*>(vm->code());
-    code->push(var);
+    compileVariable(vm, code, var);
     code->call(vm->dictionary()[L"dup"]);
     code->call(vm->dictionary()[L"sysover"]);
     code->call(vm->dictionary()[L"get"]);
@@ -729,9 +1448,10 @@ void next(VM* vm) {
 }
 
 void notEqual(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::NOT_EQUAL) || exact(vm, left, right, External::NOT_EQUAL)) return;
 
     if (bool res = left.index() != right.index(); res) {
         vm->push(res);
@@ -743,14 +1463,31 @@ void notEqual(VM* vm) {
     case STRING:   vm->push(std::get<STRING>(left) != std::get<STRING>(right));                 break;
     case EXTERNAL: vm->push(std::get<EXTERNAL>(left) != std::get<EXTERNAL>(right));             break;
     case TABLE:    vm->push(std::get<TABLE>(left)->size() != std::get<TABLE>(right)->size());   break;
+    case VECTOR:   vm->push(std::get<VECTOR>(left) != std::get<VECTOR>(right));                 break;
     case VALUEPTR: vm->push(std::get<VALUEPTR>(left) != std::get<VALUEPTR>(right));             break;
     }
 }
 
+void ordered(VM* vm) {
+    vm->allocated(sizeof(Table));
+    vm->push(new Table(true));                                              // NOLINT
+}
+
+void popBack(VM* vm) {
+    expect(vm, VECTOR);
+    vm->push(std::get<VECTOR>(vm->top())->pop());
+}
+
 void power(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::POWER) || exact(vm, left, right, External::POWER)) return;
+    if (left.index() == EXTERNAL) {
+        std::get<EXTERNAL>(left)->operate(vm, External::POWER, right);
+        vm->push(left);
+        return;
+    }
     if (right.index() > REAL || left.index() > REAL) {
         vm->push(left);
         return;
@@ -760,8 +1497,79 @@ void power(VM* vm) {
     vm->push(pow(n1, n2));                               // NOLINT
 }
 
+void push(VM* vm) {
+    vm->need(2);
+    Value value = vm->pop();
+    if (vm->top().index() != VECTOR) return;
+    vm->allocated(sizeof(Value));
+    std::get<VECTOR>(vm->top())->append(value);
+}
+
+void put(VM* vm) {
+    vm->need(3);
+    Value value = vm->pop();
+    Value at = vm->pop();
+    if (TypedArray* a = typedArray(vm->top()); a && at.index() <= REAL) a->put(size_t(asInteger(at)), value);
+}
+
+void range(VM* vm) {
+    vm->need(3);
+    Value hi = vm->pop();
+    Value lo = vm->pop();
+    Value tbl = vm->pop();
+    if (tbl.index() != TABLE) {
+        vm->push(tbl);
+        return;
+    }
+    Table* res = std::get<TABLE>(tbl)->range(lo, hi);
+    vm->push(res);
+    vm->allocated(sizeof(Table) + res->size() * EntryBytes);
+}
+
+void recv(VM* vm) {
+    Channel* ch = channelOf(vm);
+    if (auto value = ch->take(); value.has_value()) {
+        vm->progress();
+        vm->push(value.value());
+    } else vm->block();
+}
+
+void replace(VM* vm) {
+    vm->need(3);
+    Value with = vm->pop();
+    Value what = vm->pop();
+    Value val = vm->pop();
+
+    if (val.index() != STRING || what.index() != STRING || with.index() != STRING || std::get<STRING>(what).empty()) {
+        vm->push(val);
+        return;
+    }
+    const String& str = std::get<STRING>(val);
+    const String& from = std::get<STRING>(what);
+    const String& to = std::get<STRING>(with);
+    String res;
+    res.reserve(str.size());
+    size_t pos = 0;
+    for (size_t at; (at = Simd::find(str.data() + pos, str.size() - pos, from.data(), from.size())) != Simd::npos; pos += at + from.size()) {
+        res.append(str, pos, at);
+        res += to;
+    }
+    res.append(str, pos);
+    vm->push(res);
+}
+
+void reserve(VM* vm) {
+    vm->need(2);
+    Integer n = asInteger(vm->pop());
+    if (vm->top().index() != VECTOR || n <= 0) return;
+    Vector* vec = std::get<VECTOR>(vm->top());
+    // Charged as the elements arrive; reserving only has to fit.
+    if (size_t(n) > vec->size()) vm->roomFor((size_t(n) - vec->size()) * sizeof(Value));
+    vec->reserve(size_t(n));
+}
+
 void resize(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
 
     Value val = vm->pop();
     Integer size = asInteger(val);
@@ -771,18 +1579,23 @@ void resize(VM* vm) {
     if (val.index() != VALUEPTR) return;
     Value* ptr = (Value*)(std::get<VALUEPTR>(val)); // NOLINT
 
-    if (vm->code()) {
-        Code* code = vm->code();
-        String name = code->reverse()[ptr];
-        code->locals()[name].resize(size);
-    } else {
-        String name = vm->reverse()[ptr];
-        vm->globals()[name].resize(size);
+    // Locals are laid out when their word is compiled, so only globals can change size.
+    if (const VM::Global* g = vm->globalAt(ptr); g != nullptr) vm->resize(size_t(g - vm->globals().data()), size_t(size));
+}
+
+void send(VM* vm) {
+    vm->need(2);
+    Value value = vm->pop();
+    Channel* ch = channelOf(vm);
+    if (ch->put(value)) vm->progress();
+    else {
+        vm->push(value);
+        vm->block();
     }
 }
 
 void size(VM* vm) {
-    if (vm->size() < 1) return;
+    vm->need(1);
 
     Value val = vm->pop();
     if (val.index() != VALUEPTR) {
@@ -791,14 +1604,9 @@ void size(VM* vm) {
     }
 
     Value* ptr = (Value*)(std::get<VALUEPTR>(val)); // NOLINT
-    if (vm->code()) {
-        Code* code = vm->code();
-        String name = code->reverse()[ptr];
-        vm->push(Integer(code->locals()[name].size()));
-    } else {
-        String name = vm->reverse()[ptr];
-        vm->push(Integer(vm->globals()[name].size()));
-    }
+    if (size_t n = vm->localSize(ptr); n != 0) vm->push(Integer(n));
+    else if (const VM::Global* g = vm->globalAt(ptr); g != nullptr) vm->push(Integer(g->size));
+    else vm->push(0);
 }
 
 //
@@ -826,6 +1634,60 @@ void size(VM* vm) {
 //    $ (loc2) = jump 0               [ (var) (loc) ]        [ ]                   [ (by) (to) ]
 //    syspush (loc2)                  [ (var) (loc) (loc2) ] [ ]                   [ (by) (to) ]
 //
+void sleep(VM* vm) {
+    vm->need(1);
+    vm->sleep(std::chrono::milliseconds(std::max(asInteger(vm->pop()), Integer(0))));
+}
+
+void slice(VM* vm) {
+    vm->need(3);
+    Integer to = asInteger(vm->pop());
+    Integer from = asInteger(vm->pop());
+    Value val = vm->pop();
+    if (val.index() != VECTOR) {
+        vm->push(val);
+        return;
+    }
+    Vector* res = std::get<VECTOR>(val)->slice(from, to);
+    vm->push(res);
+    vm->allocated(sizeof(Vector) + res->size() * sizeof(Value));
+}
+
+void sort(VM* vm) {
+    expect(vm, VECTOR);
+    std::get<VECTOR>(vm->top())->sort();
+}
+
+// Reads the name of the word to run as a task; inside a def the task is spawned each time the def runs.
+void spawn(VM* vm) {
+    if (auto val = vm->word(true); val.has_value()) {
+        vm->pop();
+        if (val.value().index() != STRING) return;
+        String name = std::get<String>(val.value());
+        if (!vm->compiling()) {
+            vm->spawn(name);
+            return;
+        }
+        Compiled* code = dynamic_cast<Compiled*>(vm->code());
+        code->push(name);
+        code->call(vm->dictionary()[L"(spawn)"]);
+    }
+}
+
+void startsWith(VM* vm) {
+    vm->need(2);
+    Value right = vm->pop();
+    Value left = vm->pop();
+
+    if (left.index() != STRING || right.index() != STRING) {
+        vm->push(0);
+        return;
+    }
+    const String& l = std::get<STRING>(left);
+    const String& r = std::get<STRING>(right);
+    vm->push(r.size() <= l.size() && Simd::mismatch(l.data(), r.data(), r.size()) == Simd::npos);
+}
+
 void step(VM* vm) {
     if (!vm->compiling()) return;
 
@@ -834,12 +1696,12 @@ void step(VM* vm) {
     code->call(vm->dictionary()[L"sysmove"]);
     code->call(vm->dictionary()[L"sysmove"]);
     Value var = vm->systop();
-    code->push(var);
+    compileVariable(vm, code, var);
     code->call(vm->dictionary()[L"->"]);
     size_t loc = code->call(vm->dictionary()[L"sysdup"]);
     vm->syspush(Integer(loc));
     code->call(vm->dictionary()[L"move"]);
-    code->push(var);
+    compileVariable(vm, code, var);
     code->call(vm->dictionary()[L"get"]);
     code->call(vm->dictionary()[L"sysover"]);
     code->call(vm->dictionary()[L"move"]);
@@ -855,34 +1717,30 @@ void step(VM* vm) {
 }
 
 void storeLeft(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value value = vm->pop();
-    Value var = vm->pop();
-    if (var.index() != VALUEPTR) return;
-    Value* varPtr = (Value*) std::get<VALUEPTR>(var);     // NOLINT
-    *varPtr = value;
+    *reference(vm) = value;
 }
 
 void storeRight(VM* vm) {
-    if (vm->size() < 2) return;
-    Value var = vm->pop();
-    Value value = vm->pop();
-    if (var.index() != VALUEPTR) return;
-    Value* varPtr = (Value*) std::get<VALUEPTR>(var);     // NOLINT
-    *varPtr = value;
+    vm->need(2);
+    Value* var = reference(vm);
+    *var = vm->pop();
 }
 
 void subtract(VM* vm) {
-    if (vm->size() < 2) return;
+    vm->need(2);
     Value right = vm->pop();
     Value left = vm->pop();
+    if (vectorized(vm, left, right, External::SUBTRACT) || exact(vm, left, right, External::SUBTRACT)) return;
 
     if (bool res = left.index() != right.index(); res) {
         switch (left.index()) {
-        case INTEGER:  vm->push(Integer(asReal(left) - asReal(right) + Half));          break;
+        case INTEGER:  vm->push(nearest(asReal(left) - asReal(right)));                 break;
         case REAL:     vm->push(asReal(left) - asReal(right));                          break;
-        case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"-", right); vm->push(left); break;
+        case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::SUBTRACT, right); vm->push(left); break;
         case TABLE:    vm->push(std::get<TABLE>(left)->erase(right));                   break;
+        case VECTOR:
         case VALUEPTR: vm->push(left);                                                  break;
         case STRING: {
                 auto s = std::get<STRING>(left);
@@ -902,10 +1760,11 @@ void subtract(VM* vm) {
         return;
     }
     switch (left.index()) {
-    case INTEGER:  vm->push(std::get<INTEGER>(left) - std::get<INTEGER>(right));    break;
+    case INTEGER:  vm->push(checked(vm, std::get<INTEGER>(left), std::get<INTEGER>(right), External::SUBTRACT)); break;
     case REAL:     vm->push(std::get<REAL>(left) - std::get<REAL>(right));          break;
-    case EXTERNAL: std::get<EXTERNAL>(left)->send(vm, L"-", right); vm->push(left); break;
+    case EXTERNAL: std::get<EXTERNAL>(left)->operate(vm, External::SUBTRACT, right); vm->push(left); break;
     case TABLE:    vm->push(std::get<TABLE>(left)->erase(right));                   break;
+    case VECTOR:
     case VALUEPTR: vm->push(left);                                                  break;
     case STRING:   {
             auto s = asString(left);
@@ -916,8 +1775,18 @@ void subtract(VM* vm) {
     }
 }
 
-void table(VM* vm) {
+void sum(VM* vm) {
+    vm->need(1);
+    TypedArray* a = typedArray(vm->top());
+    if (a == nullptr) return;
+    vm->pop();
+    if (a->kind() == TypedArray::INT64) vm->push(Integer(Simd::sum(a->integers(), a->size())));
+    else vm->push(Real(Simd::sum(a->reals(), a->size())));
+}
 
+void table(VM* vm) {
+    vm->allocated(sizeof(Table));
+    vm->push(new Table());                                                  // NOLINT
 }
 
 void then(VM* vm) {
@@ -929,18 +1798,33 @@ void then(VM* vm) {
     }
 }
 
+void upper(VM* vm) {
+    vm->need(1);
+    Value val = vm->pop();
+    if (val.index() == STRING) {
+        String& str = std::get<STRING>(val);
+        Simd::upper(str.data(), str.size());
+    }
+    vm->push(val);
+}
+
+void values(VM* vm) {
+    expect(vm, TABLE);
+    Table* tbl = std::get<TABLE>(vm->pop());
+    for (const auto& entry: *tbl) vm->push(entry.second);
+    vm->push(Integer(tbl->size()));
+}
+
 void var(VM* vm) {
     if (auto val = vm->word(true); val.has_value()) {
         vm->pop();
         if (Value value = val.value(); value.index() == STRING) {
             auto name = std::get<String>(value);
             if (vm->compiling()) {
-                vm->code()->locals()[name] = { 0 };
-                vm->code()->reverse()[vm->code()->locals()[name].data()] = name;
+                vm->code()->declare(name);
                 return;
             }
-            vm->globals()[name] = { 0 };
-            vm->reverse()[vm->globals()[name].data()] = name;
+            vm->declare(name);
         }
     }
 }
@@ -1002,7 +1886,7 @@ void word(VM* vm) {
         // if it's a real number: push real
         pos = 0;
         try {
-            Real num = std::stold(wrd, &pos);
+            Real num = parseReal(wrd, &pos);
             if (pos == wrd.size()) {
                 vm->push(num);
                 return;
@@ -1013,47 +1897,95 @@ void word(VM* vm) {
     vm->push(wrd);
 }
 
+void yield(VM* vm) {
+    vm->yield();
+}
+
 }
 
-Fifth::VM::VM()
+Fifth::VM::VM(size_t user, size_t system)
+    : mSystem(L"system", system)
+    , mUser(L"user", user)
 {
+    mFrames.resize(FrameCapacity);
+    mReturns.reserve(FrameCapacity);
+    mGlobalSlots.resize(GlobalCapacity);
+    mGlobalOwner.resize(GlobalCapacity, uint32_t(-1));
+
     builtin(L"array",   array,      IMMEDIATE);
     builtin(L"by",      by,         IMMEDIATE | COMPILETIME);
+    builtin(L"catch",   doCatch,    IMMEDIATE | COMPILETIME);
     builtin(L"dbg",     dbg,        IMMEDIATE);
     builtin(L"def",     def,        IMMEDIATE);
     builtin(L"do",      doDo,       IMMEDIATE | COMPILETIME);
     builtin(L"done",    done,       IMMEDIATE | COMPILETIME);
     builtin(L"else",    doElse,     IMMEDIATE | COMPILETIME);
     builtin(L"endif",   doEndIf,    IMMEDIATE | COMPILETIME);
+    builtin(L"endtry",  doEndTry,   IMMEDIATE | COMPILETIME);
     builtin(L"for",     doFor,      IMMEDIATE | COMPILETIME);
     builtin(L"if",      [](VM*){ }, IMMEDIATE | COMPILETIME);
     builtin(L"next",    next,       IMMEDIATE | COMPILETIME);
-    builtin(L"each",    step,       IMMEDIATE | COMPILETIME);
+    builtin(L"each",    Fifth::step, IMMEDIATE | COMPILETIME);
     builtin(L"return",  doReturn,   IMMEDIATE | COMPILETIME);
-    builtin(L"table",   table,      IMMEDIATE);
     builtin(L"then",    then,       IMMEDIATE | COMPILETIME);
+    builtin(L"try",     doTry,      IMMEDIATE | COMPILETIME);
     builtin(L"while",   doWhile,    IMMEDIATE | COMPILETIME);
+    builtin(L"spawn",   Fifth::spawn, IMMEDIATE);
     builtin(L"var",     var,        IMMEDIATE);
 
-    builtin(L"and",     [](VM* vm) { Value right = vm->pop(); Value left = vm->pop(); vm->push(isTrue(left) && isTrue(right)); });
+    builtin(L"and",     [](VM* vm) { Value right = vm->pop(); Value left = vm->pop(); if (!vectorized(vm, left, right, External::AND)) vm->push(isTrue(left) && isTrue(right)); });
+    builtin(L"at",      at);
+    builtin(L"bigint",  bigint);
+    builtin(L"channel", channel);
     builtin(L"ch",      [](VM* vm) { cstd::out.putChar(asInteger(vm->pop())); });                                                                                        // NOLINT
+    builtin(L"compare", compare);
+    builtin(L"concat",  concat);
+    builtin(L"contains", contains);
+    builtin(L"decimal", decimal);
     builtin(L"depth",   [](VM* vm) { vm->size(); });
+    builtin(L"dot",     dot);
     builtin(L"dup",     [](VM* vm) { vm->dup(); });
     builtin(L"empty",   [](VM* vm) { vm->push(vm->empty()); });
+    builtin(L"ends-with", endsWith);
     builtin(L"explode", explode);
+    builtin(L"fill",    fill);
+    builtin(L"find",    Fifth::find);
+    builtin(L"first",   first);
+    builtin(L"float64[]", floatArray);
     builtin(L"get",     get);
+    builtin(L"int64[]", intArray);
+    builtin(L"join",    Fifth::join);
+    builtin(L"keys",    keys);
+    builtin(L"last",    last);
     builtin(L"len",     len);
+    builtin(L"lower",   lower);
+    builtin(L"max",     maximum);
+    builtin(L"min",     minimum);
     builtin(L"move",    [](VM* vm) { vm->move(); });
     builtin(L"nand",    [](VM* vm) { Value right = vm->pop(); Value left = vm->pop(); vm->push(!(isTrue(left) && isTrue(right))); });
     builtin(L"nor",     [](VM* vm) { Value right = vm->pop(); Value left = vm->pop(); vm->push(!(isTrue(left) || isTrue(right))); });
     builtin(L"nth",     [](VM* vm) { vm->push(vm->nth((asInteger(vm->pop())))); });
-    builtin(L"or",      [](VM* vm) { Value right = vm->pop(); Value left = vm->pop(); vm->push(isTrue(left) || isTrue(right)); });
+    builtin(L"ordered", ordered);
+    builtin(L"or",      [](VM* vm) { Value right = vm->pop(); Value left = vm->pop(); if (!vectorized(vm, left, right, External::OR)) vm->push(isTrue(left) || isTrue(right)); });
     builtin(L"pop",     [](VM* vm) { vm->pop(); });
+    builtin(L"pop-back", popBack);
     builtin(L"print",   [](VM* vm) { cstd::out.putString(asString(vm->pop())); });
-    builtin(L"resize",  resize);
+    builtin(L"push",    Fifth::push);
+    builtin(L"put",     put);
+    builtin(L"range",   range);
+    builtin(L"recv",    recv);
+    builtin(L"replace", Fifth::replace);
+    builtin(L"reserve", reserve);
+    builtin(L"resize",  Fifth::resize);
     builtin(L"rot",     [](VM* vm) { vm->rot(); });
     builtin(L"rrot",    [](VM* vm) { vm->rrot(); });
+    builtin(L"send",    send);
     builtin(L"size",    Fifth::size);
+    builtin(L"sleep",   Fifth::sleep);
+    builtin(L"slice",   slice);
+    builtin(L"sort",    Fifth::sort);
+    builtin(L"starts-with", startsWith);
+    builtin(L"sum",     sum);
     builtin(L"swap",    [](VM* vm) { vm->swap(); });
     builtin(L"sysdup",  [](VM* vm) { vm->sysdup(); });
     builtin(L"sysmove", [](VM* vm) { vm->sysmove(); });
@@ -1062,11 +1994,27 @@ Fifth::VM::VM()
     builtin(L"syspop",  [](VM* vm) { vm->syspop(); });
     builtin(L"sysswap", [](VM* vm) { Value x = vm->syspop(), y = vm->pop(); vm->syspush(y); vm->push(x); });
     builtin(L"systop",  [](VM* vm) { vm->push(vm->systop()); });
-    builtin(L"vector",  [](VM* vm) { Vector* v = new Vector(); vm->push(v); });                                                                                          // NOLINT
+    builtin(L"table",   table);
+    builtin(L"throw",   doThrow);
+    builtin(L"upper",   upper);
+    builtin(L"values",  values);
+    builtin(L"vector",  [](VM* vm) { vm->allocated(sizeof(Vector)); vm->push(new Vector()); });                                                                                                         // NOLINT
     builtin(L"word",    Fifth::word);
+    builtin(L"yield",   Fifth::yield);
     builtin(L"xor",     [](VM* vm) { Value right = vm->pop(); Value left = vm->pop(); vm->push((isTrue(left) || isTrue(right)) && !(isTrue(left) && isTrue(right))); });
 
     builtin(L"(",  algebra, IMMEDIATE);
+    builtin(L"(spawn)", [](VM* vm) { expect(vm, STRING); vm->spawn(std::get<String>(vm->pop())); });
+    builtin(L"(square)", [](VM* vm) {                   // x ^ 2 in compiled algebra
+        vm->need(1);
+        if (vm->top().index() > REAL) {
+            vm->push(Integer(2));
+            power(vm);
+        } else {
+            Real x = asReal(vm->pop());
+            vm->push(x * x);
+        }
+    });
 
     builtin(L"[]",  index);
     builtin(L"[*]", fetch);
@@ -1085,6 +2033,589 @@ Fifth::VM::VM()
     builtin(L"/",   divide);
     builtin(L"%",   modulo);
     builtin(L"^",   power);
+
+    for (int op = 0; op < Compiled::OPERATORS; ++op) mOperators[op] = mDictionary[Compiled::symbol(op)];
+}
+
+Fifth::Value Fifth::TypedArray::at(size_t i) const {
+    if (mKind == INT64) return mIntegers[i];
+    return Real(mReals[i]);
+}
+
+void Fifth::TypedArray::fill(const Value& v) {
+    if (mKind == INT64) std::fill(mIntegers.begin(), mIntegers.end(), asInteger(v));
+    else std::fill(mReals.begin(), mReals.end(), double(asReal(v)));
+}
+
+const wchar_t* Fifth::External::symbol(Operator op) {
+    static const wchar_t* symbols[OPERATORS] = {                                                             // NOLINT
+        L"+", L"-", L"*", L"/", L"<", L"<=", L">", L">=", L"%", L"^", L"=", L"<>", L"and", L"or"
+    };
+    return op < OPERATORS ? symbols[op] : L"";                                                               // NOLINT
+}
+
+// The elements at rows, in that order, as a new array of the same kind.
+Fifth::TypedArray* Fifth::TypedArray::gather(const std::vector<size_t>& rows) const {
+    auto* arr = new TypedArray(mKind, rows.size());                            // NOLINT
+    if (mKind == INT64) for (size_t i = 0; i < rows.size(); ++i) arr->mIntegers[i] = mIntegers[rows[i]];
+    else for (size_t i = 0; i < rows.size(); ++i) arr->mReals[i] = mReals[rows[i]];
+    return arr;
+}
+
+void Fifth::TypedArray::put(size_t i, const Value& v) {
+    if (i >= size()) return;
+    if (mKind == INT64) mIntegers[i] = asInteger(v);
+    else mReals[i] = double(asReal(v));
+}
+
+void Fifth::TypedArray::operate(VM*, Operator op, const Value& right) {
+    TypedArray* other = typedArray(right);
+    if (other == nullptr && right.index() != INTEGER && right.index() != REAL) return;
+    if (other != nullptr && other->size() != size()) return;
+
+    size_t n = size();
+    bool real = mKind == FLOAT64 || (other != nullptr ? other->kind() == FLOAT64 : right.index() == REAL);
+    if (op == POWER) {
+        toReals();
+        std::vector<double> by = other != nullptr ? realsOf(other) : std::vector<double>(n, double(asReal(right)));
+        for (size_t i = 0; i < n; ++i) mReals[i] = std::pow(mReals[i], by[i]);
+        return;
+    }
+    // Integer division traps on a zero divisor, and on -1 when the dividend is the most negative number, so the
+    // divisors are checked before any element changes; over -1 the quotient is the negation, wrapping like + and *.
+    bool negates = false;
+    if (op == MODULO || (op == DIVIDE && !real)) {
+        for (size_t i = 0; i < (other != nullptr ? n : 1); ++i) {
+            Integer by = other != nullptr ? asInteger(other->at(i)) : asInteger(right);
+            if (by == 0) throw Error(Error::DIVIDE_BY_ZERO, L"division by zero");
+            negates |= by == -1;
+        }
+    }
+    // Integer elements over a real 0 trap the same way, rather than leave an infinity no Integer holds.
+    if (op == DIVIDE && real && mKind == INT64) {
+        for (size_t i = 0; i < (other != nullptr ? n : 1); ++i) {
+            if ((other != nullptr ? other->reals()[i] : double(asReal(right))) == 0) throw Error(Error::DIVIDE_BY_ZERO, L"division by zero");
+        }
+    }
+    if (op == MODULO) {
+        toIntegers();
+        for (size_t i = 0; i < n; ++i) {
+            Integer by = other != nullptr ? asInteger(other->at(i)) : asInteger(right);
+            mIntegers[i] = by == -1 ? 0 : mIntegers[i] % by;
+        }
+        return;
+    }
+    if (op == DIVIDE && negates) {
+        for (size_t i = 0; i < n; ++i) {
+            Integer by = other != nullptr ? other->mIntegers[i] : asInteger(right);
+            mIntegers[i] = by == -1 ? Integer(0 - uint64_t(mIntegers[i])) : mIntegers[i] / by;
+        }
+        return;
+    }
+
+    if (op >= EQUAL && op <= OR) {
+        auto apply = [op](auto l, auto r) -> Integer {
+            switch (op) {
+            case EQUAL:     return l == r;
+            case NOT_EQUAL: return l != r;
+            case AND:       return l != 0 && r != 0;
+            default:        return l != 0 || r != 0;
+            }
+        };
+        std::vector<Integer> out(n);
+        if (real) {
+            std::vector<double> l = realsOf(this);
+            std::vector<double> r = other != nullptr ? realsOf(other) : std::vector<double>(n, double(asReal(right)));
+            for (size_t i = 0; i < n; ++i) out[i] = apply(l[i], r[i]);
+        } else {
+            Integer by = other != nullptr ? 0 : asInteger(right);
+            for (size_t i = 0; i < n; ++i) out[i] = apply(mIntegers[i], other != nullptr ? other->mIntegers[i] : by);
+        }
+        mIntegers = std::move(out);
+        mReals.clear();
+        mKind = INT64;
+        return;
+    }
+
+    if (op > GREATER_EQUAL) return;
+    auto code = Simd::Op(op);
+    if (code >= Simd::LESS) {
+        if (real) {
+            std::vector<double> l = realsOf(this);
+            std::vector<double> r = other != nullptr ? realsOf(other) : std::vector<double>();
+            mIntegers.resize(n);
+            Simd::compare(code, mIntegers.data(), l.data(), other != nullptr ? r.data() : nullptr, other != nullptr ? 0.0 : double(asReal(right)), n);
+            mReals.clear();
+            mKind = INT64;
+        } else Simd::compare(code, integers(), integers(), other != nullptr ? other->integers() : nullptr, other != nullptr ? 0 : asInteger(right), n);
+        return;
+    }
+    if (mKind == FLOAT64) {
+        std::vector<double> r = other != nullptr ? realsOf(other) : std::vector<double>();
+        Simd::apply(code, reals(), other != nullptr ? r.data() : nullptr, other != nullptr ? 0.0 : double(asReal(right)), n);
+    } else if (!real) Simd::apply(code, integers(), other != nullptr ? other->integers() : nullptr, other != nullptr ? 0 : asInteger(right), n);
+    else {
+        // Integer elements with a real operand round the way Integer arithmetic does, unless a result is one no Integer
+        // holds; then the array becomes FLOAT64 and keeps the results as they are.
+        std::vector<double> out(n);
+        for (size_t i = 0; i < n; ++i) {
+            double l = double(mIntegers[i]);
+            double r = other != nullptr ? other->reals()[i] : double(asReal(right));
+            out[i] = code == Simd::ADD ? l + r : code == Simd::SUBTRACT ? l - r : code == Simd::MULTIPLY ? l * r : l / r;
+        }
+        if (std::all_of(out.begin(), out.end(), [](double x) { return whole(x + Half); })) {
+            for (size_t i = 0; i < n; ++i) mIntegers[i] = Integer(out[i] + Half);
+        } else {
+            mReals = std::move(out);
+            mIntegers.clear();
+            mKind = FLOAT64;
+        }
+    }
+}
+
+// The positions of the elements that are non-zero, or that are zero.
+std::vector<size_t> Fifth::TypedArray::where(bool set) const {
+    std::vector<size_t> rows;
+    for (size_t i = 0; i < size(); ++i) {
+        bool nonzero = mKind == INT64 ? mIntegers[i] != 0 : mReals[i] != 0.0;
+        if (nonzero == set) rows.push_back(i);
+    }
+    return rows;
+}
+
+Fifth::Real Fifth::Element::toReal() {
+    Value* v = value();
+    return v != nullptr ? asReal(*v) : 0.0;
+}
+
+Fifth::String Fifth::Element::toString() {
+    Value* v = value();
+    return v != nullptr ? asString(*v) : L"[" + std::to_wstring(mAt) + L"]";
+}
+
+Fifth::Integer Fifth::Element::toInteger() {
+    Value* v = value();
+    return v != nullptr ? asInteger(*v) : 0;
+}
+
+Fifth::String Fifth::TypedArray::toString() {
+    static constexpr size_t Shown = 16;
+    String res = mKind == INT64 ? L"int64[" : L"float64[";
+    for (size_t i = 0; i < size() && i < Shown; ++i) res += (i ? L", " : L"") + asString(at(i));
+    if (size() > Shown) res += L", ...";
+    return res + L"]";
+}
+
+void Fifth::TypedArray::toIntegers() {
+    if (mKind == INT64) return;
+    mIntegers.assign(mReals.begin(), mReals.end());
+    mReals.clear();
+    mKind = INT64;
+}
+
+void Fifth::TypedArray::toReals() {
+    if (mKind == FLOAT64) return;
+    mReals.assign(mIntegers.begin(), mIntegers.end());
+    mIntegers.clear();
+    mKind = FLOAT64;
+}
+
+static constexpr uint8_t  Empty   = 0x80;
+static constexpr uint8_t  Deleted = 0xFE;
+static constexpr size_t   Group   = 8;
+static constexpr uint64_t Lsbs    = 0x0101010101010101ULL;
+static constexpr uint64_t Msbs    = 0x8080808080808080ULL;
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    return x ^ (x >> 33);
+}
+
+// Control words hold one byte per slot, lowest address in the low byte. A match leaves the top bit of each matching byte set.
+static uint64_t controlWord(const uint8_t* at) { uint64_t w = 0; for (size_t i = 0; i < Group; ++i) w |= uint64_t(at[i]) << (8 * i); return w; }
+static uint64_t matchTag(uint64_t w, uint8_t tag) { uint64_t x = w ^ (Lsbs * tag); return (x - Lsbs) & ~x & Msbs; }
+static uint64_t matchEmpty(uint64_t w)            { return w & (~w << 6) & Msbs; }
+static uint64_t matchFree(uint64_t w)             { return w & Msbs; }
+static size_t firstSlot(uint64_t match)           { return size_t(__builtin_ctzll(match)) / 8; }
+
+size_t Fifth::hash(const Value& v) {
+    switch (v.index()) {
+    case INTEGER:  return mix(uint64_t(std::get<INTEGER>(v)));
+    case REAL: {
+            double d = double(std::get<REAL>(v));
+            if (d == 0.0) d = 0.0;
+            uint64_t bits = 0;
+            memcpy(&bits, &d, sizeof(bits));
+            return mix(bits ^ 0x9E3779B97F4A7C15ULL);
+        }
+    case STRING: {
+            uint64_t h = 0xCBF29CE484222325ULL;
+            for (const auto ch: std::get<STRING>(v)) h = (h ^ uint64_t(ch)) * 0x100000001B3ULL;
+            return mix(h);
+        }
+    case EXTERNAL: return mix(uint64_t(uintptr_t(std::get<EXTERNAL>(v))));
+    case TABLE:    return mix(uint64_t(uintptr_t(std::get<TABLE>(v))));
+    case VALUEPTR: return mix(uint64_t(uintptr_t(std::get<VALUEPTR>(v))));
+    case VECTOR:   return mix(uint64_t(uintptr_t(std::get<VECTOR>(v))));
+    }
+    return 0;
+}
+
+static constexpr size_t Fanout = 32;
+
+// Key order for ordered tables: numbers by value whatever their type, everything else by kind and then value.
+static bool before(const Fifth::Value& a, const Fifth::Value& b) {
+    using namespace Fifth;
+    if (a.index() <= REAL && b.index() <= REAL && a.index() != b.index()) {
+        Real l = asReal(a);
+        Real r = asReal(b);
+        return l < r || (l == r && a.index() < b.index());
+    }
+    return a < b;
+}
+
+static size_t lowerIn(const std::vector<Fifth::Value>& keys, const Fifth::Value& x) {
+    return size_t(std::lower_bound(keys.begin(), keys.end(), x, before) - keys.begin());
+}
+
+static size_t upperIn(const std::vector<Fifth::Value>& keys, const Fifth::Value& x) {
+    return size_t(std::upper_bound(keys.begin(), keys.end(), x, before) - keys.begin());
+}
+
+Fifth::Table::Table(bool ordered) {
+    if (!ordered) return;
+    mRoot = std::make_unique<Node>();
+    mHead = mTail = mRoot.get();
+}
+
+Fifth::Value& Fifth::Table::operator[](const Value& x) {
+    if (mRoot) {
+        if (uint32_t* at = lookup(x); at != nullptr) return mEntries[*at].second;
+        uint32_t at = allocate(x, 0);
+        insert(x, at);
+        return mEntries[at].second;
+    }
+
+    size_t h = hash(x);
+    if (size_t slot = slotOf(x, h); slot != size_t(-1)) return mEntries[mIndex[slot]].second;
+
+    if ((mSize + mDeleted + 1) * 8 > mControl.size() * 7) rehash(mSize * 8 >= mControl.size() * 3 ? std::max(mControl.size() * 2, Group * 2) : mControl.size());
+    size_t groups = mControl.size() / Group;
+    size_t slot = 0;
+    for (size_t g = (h >> 7) & (groups - 1), step = 0; ; g = (g + ++step) & (groups - 1)) {
+        if (uint64_t free = matchFree(controlWord(&mControl[g * Group])); free != 0) {
+            slot = g * Group + firstSlot(free);
+            break;
+        }
+    }
+    if (mControl[slot] == Deleted) --mDeleted;
+    mControl[slot] = uint8_t(h & 0x7F);
+    mIndex[slot] = allocate(x, h);
+    return mEntries[mIndex[slot]].second;
+}
+
+uint32_t Fifth::Table::allocate(const Value& x, size_t h) {
+    uint32_t at = 0;
+    if (mFree.empty()) {
+        at = uint32_t(mEntries.size());
+        mEntries.emplace_back();
+    } else {
+        at = mFree.back();
+        mFree.pop_back();
+    }
+    Entry& entry = mEntries[at];
+    entry.first = x;
+    entry.second = 0;
+    entry.hash = h;
+    entry.live = true;
+    entry.prev = mNewest;
+    entry.next = None;
+    (mNewest == None ? mOldest : mEntries[mNewest].next) = at;
+    mNewest = at;
+    ++mSize;
+    return at;
+}
+
+Fifth::Table* Fifth::Table::append(const Table* m) {
+    if (m == this) return this;
+    for (uint32_t at = m->mOldest; at != None; at = m->mEntries[at].next) {
+        const Entry& entry = m->mEntries[at];
+        if (!contains(entry.first)) (*this)[entry.first] = entry.second;
+    }
+    return this;
+}
+
+void Fifth::Table::clear() {
+    mControl.clear();
+    mIndex.clear();
+    mEntries.clear();
+    mFree.clear();
+    mOldest = mNewest = None;
+    mSize = 0;
+    mDeleted = 0;
+    if (mRoot) {
+        mRoot = std::make_unique<Node>();
+        mHead = mTail = mRoot.get();
+    }
+}
+
+bool Fifth::Table::contains(const Value& x) const {
+    if (mRoot) return lookup(x) != nullptr;
+    return slotOf(x, hash(x)) != size_t(-1);
+}
+
+Fifth::Table* Fifth::Table::erase(const Value& x) {
+    if (mRoot) {
+        // Leaves are allowed to underflow, even to empty: separators above them are still valid bounds.
+        size_t pos = 0;
+        auto* leaf = const_cast<Node*>(lowerBound(x, pos));                 // NOLINT
+        if (pos < leaf->keys.size() && !before(x, leaf->keys[pos])) {
+            release(leaf->entries[pos]);
+            leaf->keys.erase(leaf->keys.begin() + ptrdiff_t(pos));
+            leaf->entries.erase(leaf->entries.begin() + ptrdiff_t(pos));
+        }
+        return this;
+    }
+
+    size_t slot = slotOf(x, hash(x));
+    if (slot == size_t(-1)) return this;
+    release(mIndex[slot]);
+    mControl[slot] = Deleted;
+    ++mDeleted;
+    return this;
+}
+
+Fifth::Value* Fifth::Table::find(const Value& x) {
+    if (mRoot) {
+        uint32_t* at = lookup(x);
+        return at == nullptr ? nullptr : &mEntries[*at].second;
+    }
+    size_t slot = slotOf(x, hash(x));
+    return slot == size_t(-1) ? nullptr : &mEntries[mIndex[slot]].second;
+}
+
+Fifth::Table::Entry* Fifth::Table::first() {
+    auto at = begin();
+    return at == end() ? nullptr : &*at;
+}
+
+// Splits a node that grew past Fanout, returning the new right half and the key that separates it.
+// A leaf that only grew at its far end keeps all but the new key, so ascending inserts fill leaves completely.
+std::unique_ptr<Fifth::Table::Node> Fifth::Table::split(Node* n, bool appended, Value& separator, Node*& tail) {
+    auto right = std::make_unique<Node>();
+    right->leaf = n->leaf;
+    size_t keep = appended && n->next == nullptr ? n->keys.size() - 1 : n->keys.size() / 2;
+    if (n->leaf) {
+        right->keys.assign(n->keys.begin() + ptrdiff_t(keep), n->keys.end());
+        right->entries.assign(n->entries.begin() + ptrdiff_t(keep), n->entries.end());
+        n->keys.resize(keep);
+        n->entries.resize(keep);
+        separator = right->keys.front();
+        right->prev = n;
+        right->next = n->next;
+        if (n->next != nullptr) n->next->prev = right.get();
+        else tail = right.get();
+        n->next = right.get();
+    } else {
+        keep = n->keys.size() / 2;
+        separator = n->keys[keep];
+        right->keys.assign(n->keys.begin() + ptrdiff_t(keep) + 1, n->keys.end());
+        for (size_t i = keep + 1; i < n->children.size(); ++i) right->children.push_back(std::move(n->children[i]));
+        n->keys.resize(keep);
+        n->children.resize(keep + 1);
+    }
+    return right;
+}
+
+std::unique_ptr<Fifth::Table::Node> Fifth::Table::insertInto(Node* n, const Value& x, uint32_t at, Value& separator, Node*& tail) {
+    if (n->leaf) {
+        size_t pos = lowerIn(n->keys, x);
+        n->keys.insert(n->keys.begin() + ptrdiff_t(pos), x);
+        n->entries.insert(n->entries.begin() + ptrdiff_t(pos), at);
+        if (n->keys.size() <= Fanout) return nullptr;
+        return split(n, pos + 1 == n->keys.size(), separator, tail);
+    }
+    size_t child = upperIn(n->keys, x);
+    Value up;
+    auto grown = insertInto(n->children[child].get(), x, at, up, tail);
+    if (!grown) return nullptr;
+    n->keys.insert(n->keys.begin() + ptrdiff_t(child), up);
+    n->children.insert(n->children.begin() + ptrdiff_t(child) + 1, std::move(grown));
+    if (n->keys.size() <= Fanout) return nullptr;
+    return split(n, false, separator, tail);
+}
+
+void Fifth::Table::insert(const Value& x, uint32_t at) {
+    Value separator;
+    auto right = insertInto(mRoot.get(), x, at, separator, mTail);
+    if (!right) return;
+    auto root = std::make_unique<Node>();
+    root->leaf = false;
+    root->keys.push_back(separator);
+    root->children.push_back(std::move(mRoot));
+    root->children.push_back(std::move(right));
+    mRoot = std::move(root);
+}
+
+Fifth::Table::Entry* Fifth::Table::last() {
+    if (mRoot) {
+        for (const Node* leaf = mTail; leaf != nullptr; leaf = leaf->prev) if (!leaf->keys.empty()) return &mEntries[leaf->entries.back()];
+        return nullptr;
+    }
+    return mNewest == None ? nullptr : &mEntries[mNewest];
+}
+
+uint32_t* Fifth::Table::lookup(const Value& x) const {
+    size_t pos = 0;
+    const Node* leaf = lowerBound(x, pos);
+    if (pos < leaf->keys.size() && !before(x, leaf->keys[pos])) return const_cast<uint32_t*>(&leaf->entries[pos]); // NOLINT
+    return nullptr;
+}
+
+const Fifth::Table::Node* Fifth::Table::lowerBound(const Value& x, size_t& pos) const {
+    const Node* n = mRoot.get();
+    while (!n->leaf) n = n->children[upperIn(n->keys, x)].get();
+    pos = lowerIn(n->keys, x);
+    return n;
+}
+
+Fifth::Table* Fifth::Table::range(const Value& lo, const Value& hi) {
+    auto* res = new Table(true);                                           // NOLINT
+    if (mRoot) {
+        size_t pos = 0;
+        const Node* leaf = lowerBound(lo, pos);
+        for (auto at = iterator(this, None, leaf, pos); at != end() && !before(hi, at->first); ++at) (*res)[at->first] = at->second;
+    } else {
+        for (const auto& entry: *this) if (!before(entry.first, lo) && !before(hi, entry.first)) (*res)[entry.first] = entry.second;
+    }
+    return res;
+}
+
+void Fifth::Table::release(uint32_t at) {
+    Entry& entry = mEntries[at];
+    entry.first = 0;
+    entry.second = 0;
+    entry.live = false;
+    (entry.prev == None ? mOldest : mEntries[entry.prev].next) = entry.next;
+    (entry.next == None ? mNewest : mEntries[entry.next].prev) = entry.prev;
+    mFree.push_back(at);
+    --mSize;
+}
+
+void Fifth::Table::rehash(size_t capacity) {
+    mControl.assign(capacity, Empty);
+    mIndex.assign(capacity, 0);
+    mDeleted = 0;
+    size_t groups = capacity / Group;
+    for (uint32_t at = 0; at < mEntries.size(); ++at) {
+        const Entry& entry = mEntries[at];
+        if (!entry.live) continue;
+        for (size_t g = (entry.hash >> 7) & (groups - 1), step = 0; ; g = (g + ++step) & (groups - 1)) {
+            if (uint64_t free = matchFree(controlWord(&mControl[g * Group])); free != 0) {
+                size_t slot = g * Group + firstSlot(free);
+                mControl[slot] = uint8_t(entry.hash & 0x7F);
+                mIndex[slot] = at;
+                break;
+            }
+        }
+    }
+}
+
+size_t Fifth::Table::slotOf(const Value& x, size_t h) const {
+    if (mSize == 0) return size_t(-1);
+    size_t groups = mControl.size() / Group;
+    auto tag = uint8_t(h & 0x7F);
+    for (size_t g = (h >> 7) & (groups - 1), step = 0; ; g = (g + ++step) & (groups - 1)) {
+        uint64_t word = controlWord(&mControl[g * Group]);
+        for (uint64_t match = matchTag(word, tag); match != 0; match &= match - 1) {
+            size_t slot = g * Group + firstSlot(match);
+            if (const Entry& entry = mEntries[mIndex[slot]]; entry.hash == h && entry.first == x) return slot;
+        }
+        if (matchEmpty(word) != 0) return size_t(-1);
+    }
+}
+
+// LSD radix sort, one byte per pass. All eight histograms come from a single scan, and a pass is skipped when every
+// key has the same byte there, so small ranges of values cost only a couple of passes.
+static void radixSort(std::vector<uint64_t>& keys) {
+    static constexpr size_t Radix = 256;
+    std::vector<size_t> counts(8 * Radix);
+    for (const auto k: keys) for (size_t b = 0; b < 8; ++b) ++counts[b * Radix + ((k >> (8 * b)) & 0xFF)];
+    std::vector<uint64_t> buffer(keys.size());
+    for (size_t b = 0; b < 8; ++b) {
+        size_t* count = &counts[b * Radix];
+        if (count[(keys[0] >> (8 * b)) & 0xFF] == keys.size()) continue;
+        size_t at = 0;
+        for (size_t i = 0; i < Radix; ++i) { size_t n = count[i]; count[i] = at; at += n; }
+        for (const auto k: keys) buffer[count[(k >> (8 * b)) & 0xFF]++] = k;
+        keys.swap(buffer);
+    }
+}
+
+template<size_t Kind> static void sortAs(std::vector<Fifth::Value>::iterator from, std::vector<Fifth::Value>::iterator to) {
+    std::vector<std::variant_alternative_t<Kind, Fifth::Value>> items;
+    items.reserve(size_t(to - from));
+    for (auto at = from; at != to; ++at) items.push_back(std::move(std::get<Kind>(*at)));
+    std::sort(items.begin(), items.end());
+    for (auto& item: items) *from++ = std::move(item);
+}
+
+Fifth::Vector* Fifth::Vector::slice(Integer from, Integer to) const {
+    Integer n = Integer(mValue.size());
+    from = std::clamp(from, Integer(0), n);
+    to = std::clamp(to, from, n);
+    return new Vector(mValue.begin() + from, mValue.begin() + to);              // NOLINT
+}
+
+void Fifth::Vector::sort() {
+    static constexpr size_t Small = 64;
+    static constexpr uint64_t Sign = 1ULL << 63;
+    if (mValue.size() < 2) return;
+
+    size_t kind = mValue[0].index();
+    bool same = std::all_of(mValue.begin(), mValue.end(), [kind](const Value& v) { return v.index() == kind; });
+    if (same && kind == INTEGER && mValue.size() >= Small) {
+        // Flipping the sign bit makes unsigned byte order match signed order.
+        std::vector<uint64_t> keys;
+        keys.reserve(mValue.size());
+        for (const auto& v: mValue) keys.push_back(uint64_t(std::get<INTEGER>(v)) ^ Sign);
+        radixSort(keys);
+        for (size_t i = 0; i < keys.size(); ++i) mValue[i] = Integer(keys[i] ^ Sign);
+    } else if (same && kind == INTEGER) sortAs<INTEGER>(mValue.begin(), mValue.end());
+    else if (same && kind == REAL) sortAs<REAL>(mValue.begin(), mValue.end());
+    else if (same && kind == STRING) sortAs<STRING>(mValue.begin(), mValue.end());
+    else std::stable_sort(mValue.begin(), mValue.end(), before);
+}
+
+size_t Fifth::Code::declare(const String& name, size_t size) {
+    if (auto at = mLocals.find(name); at != mLocals.end()) return at->second.offset;
+    mLocals[name] = { mFrameSize, size };
+    mFrameSize += size;
+    return mLocals[name].offset;
+}
+
+Fifth::String Fifth::Code::localAt(size_t offset) const {
+    for (const auto& [name, local]: mLocals) if (offset >= local.offset && offset < local.offset + local.size) return name;
+    return L"";
+}
+
+Fifth::VM::Task::Task(const String& w)
+    : word(w)
+    , user(L"user", TaskCapacity)
+    , system(L"system", TaskCapacity)
+    , frames(TaskCapacity)
+{
+    returns.reserve(TaskCapacity);
+}
+
+// Waiting for a channel: a task lets go and runs the builtin again next time; outside a task it would wait forever.
+void Fifth::VM::block() {
+    if (!suspendable()) throw Error(Error::DEADLOCK, L"would wait forever outside a task");
+    mSuspend = RETRY;
+    mTask->state = Task::BLOCKED;
 }
 
 void Fifth::VM::breakAt(int at) {
@@ -1104,19 +2635,54 @@ std::vector<Fifth::VM::At> Fifth::VM::breakPoints(Code* in)
     return points;
 }
 
+// A body for name from the cache, compiled before from what the buffer holds next while the names it used stood for
+// what they do now. The buffer is moved past the definition.
+Fifth::Compiled* Fifth::VM::cached(const String& name) {
+    if (mCache == nullptr) return nullptr;
+    auto entry = mCache->find(*this, name, mBuffer);
+    if (!entry.has_value()) return nullptr;
+    Compiled* block = CompileCache::materialize(*this, entry.value());
+    if (block == nullptr) return nullptr;
+    mBuffer.erase(0, entry->source.size());
+    depends(name, entry->uses, entry->copies);
+    earlier(name, nullptr);
+    return block;
+}
+
+// Runs a compiled word to completion. Calls it makes go on the return stack, not the native one.
+void Fifth::VM::call(Compiled* code) {
+    size_t floor = mReturns.size();
+    invoke(code);
+    interpret<NONE>(floor);
+}
+
+// Ends a debugging session, abandoning the calls it had made.
 void Fifth::VM::clearStack()
 {
-    mDebugStack.clear();
+    mReturns.clear();
+    mHandlers.clear();
+    mActive = {};
+    mFrameTop = 0;
+    mDebug = nullptr;
 }
 
+// The words def copied into name when it compiled it.
+std::set<Fifth::String> Fifth::VM::copies(const String& name) {
+    std::set<String> found;
+    for (const auto& used: mUses[name]) if (mInlinedBy[used].contains(name)) found.insert(used);
+    return found;
+}
+
+// Starts a debugging session on a word and lists its code. Stepping runs it on the return stack like any other call.
 std::vector<std::wstring> Fifth::VM::debug(const std::wstring& name) {
     std::vector<std::wstring> code;
-    mDebug = nullptr;
+    clearStack();
     if (!mDictionary.contains(name)) return code;
 
-    mDebug = mDictionary[name];
-    mPC = 0;
-    if (auto* block = dynamic_cast<Compiled*>(mDebug); block) {
+    start();
+    if (auto* block = dynamic_cast<Compiled*>(mDictionary[name]); block) {
+        invoke(block);
+        mDebug = block;
         size_t sz = block->size();
         for (size_t i = 0; i < sz; ++i) {
             String line = std::to_wstring(i) + L",";
@@ -1126,10 +2692,17 @@ std::vector<std::wstring> Fifth::VM::debug(const std::wstring& name) {
             case Compiled::POP:     line += L"POP";                                             break;
             case Compiled::SYSPOP:  line += L"SYSPOP";                                          break;
             case Compiled::RETURN:  line += L"RETURN";                                          break;
-            case Compiled::PUSH:    line += L"PUSH," + toString(this, block, instr.value());    break;
-            case Compiled::SYSPUSH: line += L"SYSPUSH," + toString(this, block, instr.value()); break;
+            case Compiled::PUSH:    line += L"PUSH," + toString(this, instr.value());    break;
+            case Compiled::SYSPUSH: line += L"SYSPUSH," + toString(this, instr.value()); break;
             case Compiled::JUMP:    line += L"JUMP," + asString(instr.by());                    break;
             case Compiled::BRANCH:  line += L"BRANCH," + asString(instr.by());                  break;
+            case Compiled::LOCAL:   line += L"LOCAL," + block->localAt(instr.by());             break;
+            case Compiled::GLOBAL:  line += L"GLOBAL," + mGlobals[instr.by()].name;            break;
+            case Compiled::TRY:     line += L"TRY," + asString(instr.by());                     break;
+            case Compiled::ENDTRY:  line += L"ENDTRY," + asString(instr.by());                  break;
+            case Compiled::INTEGER_OP: line += L"INTEGER," + Compiled::symbol(instr.by());      break;
+            case Compiled::REAL_OP:    line += L"REAL," + Compiled::symbol(instr.by());         break;
+            case Compiled::GUARDED_OP: line += L"GUARDED," + Compiled::symbol(instr.by());      break;
             case Compiled::CALL:
                 auto* code = instr.code();
                 String out = L"<unknown>";
@@ -1144,28 +2717,272 @@ std::vector<std::wstring> Fifth::VM::debug(const std::wstring& name) {
     return code;
 }
 
+// Declaring a global that exists resizes and clears it. Raises an error when the global area has no room.
+size_t Fifth::VM::declare(const String& name, size_t size) {
+    if (size_t n = globalOf(name); n != npos) {
+        resize(n, size);
+        std::fill_n(global(n), size, Value(0));
+        return n;
+    }
+    size_t offset = globalRoom(size);
+    if (offset == npos) throw Error(Error::DICTIONARY_OVERFLOW, L"global area full, no room for " + name);
+    size_t n = mGlobals.size();
+    mGlobals.push_back({ name, offset, size });
+    mGlobalNames[name] = n;
+    std::fill_n(mGlobalOwner.begin() + ptrdiff_t(offset), size, uint32_t(n));
+    mGlobalTop = std::max(mGlobalTop, offset + size);
+    mGlobalUsed += size;
+    return n;
+}
+
+// Binds name to what def compiled from source. A word that was already compiled keeps its identity and takes the new
+// body, so every call to it compiled elsewhere runs the new one; those that copied it in are compiled again. A name
+// that was undefined or a builtin gets a new word, and everything that referred to it is compiled again.
+void Fifth::VM::defined(const String& name, const String& source, Compiled* block) {
+    mSources[name] = source;
+    Code* existing = mDictionary.contains(name) ? mDictionary[name] : nullptr;
+    bool moved = existing == nullptr || !existing->compiled();
+    if (moved) {
+        mDictionary[name] = block;
+        nameOf(block, name);
+    } else {
+        static_cast<Compiled*>(existing)->swap(*block);
+        delete block;                                                     // NOLINT
+    }
+    remember(name);
+    recompile(stale(name, moved));
+}
+
+// Every word that refers to name, directly or through other words.
+std::set<Fifth::String> Fifth::VM::dependents(const String& name) {
+    std::set<String> found;
+    std::vector<String> pending = { name };
+    while (!pending.empty()) {
+        String next = pending.back();
+        pending.pop_back();
+        for (const auto& user: mUsedBy[next]) if (user != name && found.insert(user).second) pending.push_back(user);
+    }
+    return found;
+}
+
+// Records the words name refers to and those of them def copied into it, in place of what it referred to before.
+void Fifth::VM::depends(const String& name, const std::set<String>& uses, const std::set<String>& copies) {
+    for (const auto& used: mUses[name]) {
+        mUsedBy[used].erase(name);
+        mInlinedBy[used].erase(name);
+    }
+    mUses[name] = uses;
+    for (const auto& used: uses) mUsedBy[used].insert(name);
+    for (const auto& copied: copies) mInlinedBy[copied].insert(name);
+}
+
+void Fifth::VM::enter(Code* code) {
+    size_t size = code->frameSize();
+    if (mFrames.size() - mFrameTop < size) throw Error(Error::FRAME_OVERFLOW, L"frame area full, calls nested too deeply");
+    if (mLimits.depth != 0 && mActive.depth >= mLimits.depth) throw Error(Error::DEPTH_LIMIT, L"call depth limit reached");
+    mActive = { code, mFrameTop, mActive.depth + 1 };
+    std::fill_n(mFrames.begin() + ptrdiff_t(mFrameTop), size, Value(0));
+    mFrameTop += size;
+}
+
+// A branch on a column in runColumns(): the rows where the mask is set go to taken, the others on to the next
+// instruction. When they do not all agree, each selection runs the rest of the current call by itself, with the
+// columns on the stacks and in the frames cut down to its rows, and the stacks the two leave are put back together row
+// by row once the call has returned. Arrays as long as the mask are taken to be columns. An error that leaves either
+// selection fails the whole run: no handler outside the branch can catch it. Returns where to carry on when every row
+// goes the same way, otherwise npos.
+// Puts the stacks and frames back as they were before diverge() cut them down.
+void Fifth::VM::restore(const std::vector<Value>& user, const std::vector<Value>& system, const std::vector<Value>& frames) {
+    mUser.clear();
+    for (const auto& v: user) mUser.push(v);
+    mSystem.clear();
+    for (const auto& v: system) mSystem.push(v);
+    std::copy(frames.begin(), frames.end(), mFrames.begin());
+    mFrameTop = frames.size();
+}
+
+size_t Fifth::VM::diverge(TypedArray* mask, size_t taken) {
+    std::array<std::vector<size_t>, 2> selected { mask->where(false), mask->where(true) };
+    size_t rows = mask->size();
+    size_t pc = mReturns.back().pc;
+    if (selected[1].empty()) return pc;
+    if (selected[0].empty()) return taken;
+    if (mDiverging == DivergeLimit) throw Error(Error::DEPTH_LIMIT, L"columnar branches nested too deeply");
+
+    std::vector<Value> user(mUser.begin(), mUser.end());
+    std::vector<Value> system(mSystem.begin(), mSystem.end());
+    std::vector<Value> frames(mFrames.begin(), mFrames.begin() + ptrdiff_t(mFrameTop));
+    std::vector<Return> returns = mReturns;
+    std::vector<Handler> handlers = mHandlers;
+    Activation active = mActive;
+    std::array<std::vector<Value>, 2> users, systems;
+    // Counted open until both ways are done, however that ends.
+    struct Open {
+        size_t& depth;
+        explicit Open(size_t& d): depth(d) { ++depth; }
+        ~Open() { --depth; }
+    };
+    try {
+        Open open(mDiverging);
+        for (size_t way = 0; way < 2; ++way) {
+            mReturns.assign(returns.begin(), returns.end());
+            mHandlers.assign(handlers.begin(), handlers.end());
+            mActive = active;
+            mFrameTop = frames.size();
+            mReturns.back().pc = way == 1 ? taken : pc;
+            mUser.clear();
+            for (const auto& v: user) mUser.push(cut(this, v, rows, selected[way]));
+            mSystem.clear();
+            for (const auto& v: system) mSystem.push(cut(this, v, rows, selected[way]));
+            for (size_t i = 0; i < frames.size(); ++i) mFrames[i] = cut(this, frames[i], rows, selected[way]);
+            interpret<NONE>(returns.size() - 1);
+            users[way].assign(mUser.begin(), mUser.end());
+            systems[way].assign(mSystem.begin(), mSystem.end());
+        }
+    } catch (...) {
+        // Only some rows failed, and a handler outside the branch has nothing to give the rest: the run fails.
+        restore(user, system, frames);
+        mBranchFailed = true;
+        throw;
+    }
+
+    // The caller's frames go back to their whole columns.
+    std::copy(frames.begin(), frames.begin() + ptrdiff_t(mFrameTop), mFrames.begin());
+    if (users[0].size() != users[1].size() || systems[0].size() != systems[1].size()) {
+        restore(user, system, frames);
+        throw Error(Error::CONTROL_MISMATCH, L"columnar branches left stacks of different depths");
+    }
+    mUser.clear();
+    for (size_t i = 0; i < users[0].size(); ++i) mUser.push(merged(this, selected, rows, { users[0][i], users[1][i] }));
+    mSystem.clear();
+    for (size_t i = 0; i < systems[0].size(); ++i) mSystem.push(merged(this, selected, rows, { systems[0][i], systems[1][i] }));
+    return npos;
+}
+
+void Fifth::VM::exchange(Task& task) {
+    std::swap(mUser, task.user);
+    std::swap(mSystem, task.system);
+    std::swap(mFrames, task.frames);
+    std::swap(mFrameTop, task.frameTop);
+    std::swap(mActive, task.active);
+    std::swap(mReturns, task.returns);
+    std::swap(mHandlers, task.handlers);
+}
+
 bool Fifth::VM::execute(const std::wstring& s) {
     buffer(s);
+    mError.clear();
+    start();
+
+    try {
+        bool first = true;
+        for ( ; ; ) {
+            auto val = word(first);
+            first = false;;
+            if (!val.has_value()) break;
+
+            Value value = val.value();
+            if (value.index() == STRING) {
+                String word = std::get<String>(value);
+                if (mDictionary.contains(word)) {
+                    pop();
+                    Code* code = mDictionary[word];
+                    if (code->compileTime()) continue;
+                    code->exec(this);
+                } else if (size_t g = globalOf(word); g != npos) {
+                    pop();
+                    push((void*) global(g));
+                }
+            }
+        }
+    } catch (const Error& e) {
+        recover(e);
+        return false;
+    } catch (const std::exception& e) {
+        String what;
+        for (const char* c = e.what(); *c; ++c) what += wchar_t(*c);
+        recover(Error(Error::ABORTED, what));
+        return false;
+    }
+    return true;
+}
 
-    bool first = true;
-    for ( ; ; ) {
-        auto val = word(first);
-        first = false;;
-        if (!val.has_value()) break;
+// Runs one word over many rows: each is pushed on an empty user stack, the word runs, and what it leaves, or the error
+// that stopped it, goes to the sink. Nothing is tokenized or looked up per row, and the instruction budget and time
+// slice start over for each. The user stack is left empty. Returns how many rows the word finished.
+size_t Fifth::VM::runBatch(Code* word, std::span<const Row> rows, const Sink& sink) {
+    mError.clear();
+    size_t done = 0;
+    for (size_t n = 0; n < rows.size(); ++n) {
+        mUser.clear();
+        mSystem.clear();
+        start();
+        try {
+            for (const auto& v: rows[n]) mUser.push(v);
+            if (word->compiled()) call(static_cast<Compiled*>(word));
+            else word->exec(this);
+            sink(n, std::span<const Value>(mUser.begin(), mUser.end()), nullptr);
+            ++done;
+        } catch (const Error& e) {
+            recover(e);
+            sink(n, std::span<const Value>(mUser.begin(), mUser.end()), &e);
+        } catch (const std::exception& e) {
+            String what;
+            for (const char* c = e.what(); *c; ++c) what += wchar_t(*c);
+            Error error(Error::ABORTED, what);
+            recover(error);
+            sink(n, std::span<const Value>(mUser.begin(), mUser.end()), &error);
+        }
+    }
+    mUser.clear();
+    return done;
+}
 
-        Value value = val.value();
-        if (value.index() == STRING) {
-            String word = std::get<String>(value);
-            if (mDictionary.contains(word)) {
-                pop();
-                Code* code = mDictionary[word];
-                if (code->compileTime()) continue;
-                code->exec(this);
-            } else if (mGlobals.contains(word)) {
-                pop();
-                push((void*) mGlobals[word].data());
+// Runs one word over whole columns instead of row by row: each column goes on the stack as a single slot and the
+// numeric and logical builtins work through all its rows at once; a branch on a column splits the rows, see
+// diverge(). On success out holds what the word left, a number common to every row repeated into a column. The user
+// stack is left empty.
+bool Fifth::VM::runColumns(Code* word, std::span<TypedArray* const> columns, std::vector<Value>& out) {
+    mError.clear();
+    mUser.clear();
+    mSystem.clear();
+    out.clear();
+    start();
+    size_t rows = columns.empty() ? 0 : columns.front()->size();
+    mColumnar = true;
+    // However the run ends, the batch's values come off the stack and no branch is left open.
+    struct Done {
+        VM* vm;
+        ~Done() {
+            vm->mColumnar = false;
+            vm->mDiverging = 0;
+            vm->mBranchFailed = false;
+            vm->mUser.clear();
+        }
+    } done{ this };
+    try {
+        for (auto* column: columns) {
+            if (column->size() != rows) throw Error(Error::TYPE_MISMATCH, L"columns of different lengths");
+            push(static_cast<External*>(column));
+        }
+        if (word->compiled()) call(static_cast<Compiled*>(word));
+        else word->exec(this);
+        for (const auto& v: mUser) {
+            if (v.index() > REAL) out.push_back(v);
+            else {
+                TypedArray* column = newArray(this, v.index() == REAL ? TypedArray::FLOAT64 : TypedArray::INT64, rows);
+                column->fill(v);
+                out.push_back(static_cast<External*>(column));
             }
         }
+    } catch (const Error& e) {
+        recover(e);
+        return false;
+    } catch (const std::exception& e) {
+        String what;
+        for (const char* c = e.what(); *c; ++c) what += wchar_t(*c);
+        recover(Error(Error::ABORTED, what));
+        return false;
     }
     return true;
 }
@@ -1179,86 +2996,496 @@ std::vector<std::wstring> Fifth::VM::getCompiled()
     return names;
 }
 
-std::vector<std::wstring> Fifth::VM::globalVars()
-{
-    std::vector<std::wstring> vars;
-    Compiled* code = dynamic_cast<Compiled*>(mDebug);
-    for (auto& x: globals()) {
-        Value val = *(Value*) x.second.data();
-        vars.push_back(x.first + L"," + toString(this, code, val));
+// What name stood for when a word using it was compiled. A compiled word's fingerprint covers its source and, through
+// theirs, everything it uses; anything else is told apart only by its kind.
+uint64_t Fifth::VM::fingerprint(const String& name) {
+    if (auto at = mDictionary.find(name); at != mDictionary.end()) {
+        if (at->second->compiled() && mFingerprints.contains(name)) return mFingerprints[name];
+        return CompileCache::hash((at->second->immediate() ? L"immediate " : L"builtin ") + name);
     }
-    return vars;
+    return CompileCache::hash((globalOf(name) != npos ? L"global " : L"name ") + name);
 }
 
-std::vector<std::wstring> Fifth::VM::localVars()
-{
-    std::vector<std::wstring> vars;
-    Compiled* code = dynamic_cast<Compiled*>(mDebug);
-    for (auto& x: mDebug->locals()) {
-        Value val = *(Value*) x.second.data();
-        vars.push_back(x.first + L"," + toString(this, code, val));
+// A value as the debugger shows it, a pointer by the name of the variable it points at.
+Fifth::String Fifth::VM::format(const Value& v) {
+    return toString(this, v);
+}
+
+// Where size free global slots start: the first hole left by a global that moved or shrank that is big enough, else the
+// top of the area. npos if neither has room.
+size_t Fifth::VM::globalRoom(size_t size) const {
+    size_t run = 0;
+    if (mGlobalUsed < mGlobalTop) {
+        for (size_t at = 0; at < mGlobalTop; ++at) {
+            run = mGlobalOwner[at] == uint32_t(-1) ? run + 1 : 0;
+            if (run == size) return at + 1 - size;
+        }
+    }
+    size_t from = mGlobalTop - run;
+    return GlobalCapacity - from >= size ? from : npos;
+}
+
+const Fifth::VM::Global* Fifth::VM::globalAt(const Value* ptr) const {
+    if (ptr < mGlobalSlots.data() || ptr >= mGlobalSlots.data() + mGlobalTop) return nullptr;
+    uint32_t owner = mGlobalOwner[size_t(ptr - mGlobalSlots.data())];
+    return owner != uint32_t(-1) ? &mGlobals[owner] : nullptr;
+}
+
+// The numeric opcodes, for operands def or the guard has found to be both T. Gives what the builtin would, an Integer
+// that overflows carrying on as a BigInt included.
+template<typename T>
+void Fifth::VM::operate(int op) {
+    T right = std::get<T>(mUser.pop());
+    T left = std::get<T>(mUser.pop());
+    switch (op) {
+    case Compiled::ADD:           mUser.push(checked(this, left, right, External::ADD));      break;
+    case Compiled::SUBTRACT:      mUser.push(checked(this, left, right, External::SUBTRACT)); break;
+    case Compiled::MULTIPLY:      mUser.push(checked(this, left, right, External::MULTIPLY)); break;
+    case Compiled::LESS:          mUser.push(left < right);  break;
+    case Compiled::LESS_EQUAL:    mUser.push(left <= right); break;
+    case Compiled::GREATER:       mUser.push(left > right);  break;
+    case Compiled::GREATER_EQUAL: mUser.push(left >= right); break;
+    case Compiled::EQUAL:         mUser.push(left == right); break;
+    case Compiled::NOT_EQUAL:     mUser.push(left != right); break;
+    }
+}
+
+// The interpreter proper, for running and for the debugger alike. Runs until the call that was on top of the return
+// stack when it started returns or, when stepping, for one instruction. A task's run also ends when a builtin suspends
+// it; the task carries on from its return stack when it is resumed.
+template<Fifth::VM::Step S>
+void Fifth::VM::interpret(size_t floor) {
+    size_t outer = mFloor;
+    mFloor = floor;
+    Return* r = &mReturns.back();
+    const Compiled::Instruction* block = r->code->data();
+    Value* locals = frame();
+    // Instructions are charged to the budget a straight run at a time, from 'from' up to a call or backward jump.
+    size_t pc = r->pc, from = pc;
+    for (; ; ) {
+        try {
+            for (; ; ) {
+                const auto& in = block[pc++];
+                switch (in.op()) {
+                case Compiled::NOP:                                               break;
+                case Compiled::PUSH:    push(in.value());                         break;
+                case Compiled::SYSPUSH: syspush(in.value());                      break;
+                case Compiled::POP:     pop();                                    break;
+                case Compiled::SYSPOP:  syspop();                                 break;
+                case Compiled::CALL:
+                    tick(pc - from);
+                    from = pc;
+                    if (in.code()->compiled()) {
+                        auto* callee = static_cast<Compiled*>(in.code());
+                        if constexpr (S == OVER) {
+                            call(callee);
+                            break;
+                        }
+                        // A call straight before a return takes its caller's place, unless the caller has locals
+                        // (their addresses may have been passed on) or a try still open.
+                        if (block[pc].op() == Compiled::RETURN && r->code->frameSize() == 0
+                                && (mHandlers.empty() || mHandlers.back().calls < mReturns.size())) {
+                            leave(r->caller);
+                            enter(callee);
+                            r->code = callee;
+                        } else {
+                            r->pc = pc;
+                            invoke(callee);
+                            r = &mReturns.back();
+                        }
+                        block = callee->data();
+                        locals = frame();
+                        pc = from = 0;
+                        break;
+                    }
+                    static_cast<Builtin*>(in.code())->function()(this);
+                    if (mSuspend != RUNNING && floor == 0 && mTask != nullptr) {
+                        r->pc = mSuspend == RETRY ? pc - 1 : pc;
+                        mFloor = outer;
+                        return;
+                    }
+                    break;
+                case Compiled::JUMP:
+                    if (in.by() < 0) { tick(pc - from); from = pc + in.by(); }
+                    pc += in.by();
+                    break;
+                case Compiled::BRANCH:
+                    if (TypedArray* mask = mColumnar ? typedArray(top()) : nullptr; mask != nullptr) {
+                        pop();
+                        tick(pc - from);
+                        r->pc = from = pc;
+                        if (size_t next = diverge(mask, pc + in.by()); next != npos) {
+                            pc = from = next;
+                            break;
+                        }
+                        // Both selections have run the rest of this call.
+                        if (mReturns.size() == floor) {
+                            mFloor = outer;
+                            return;
+                        }
+                        r = &mReturns.back();
+                        block = r->code->data();
+                        locals = frame();
+                        pc = from = r->pc;
+                        break;
+                    }
+                    if (isTrue(pop())) pc += in.by();
+                    break;
+                case Compiled::LOCAL:   push((void*)(locals + in.by()));          break;
+                case Compiled::GLOBAL:  push((void*) global(in.by()));            break;
+                case Compiled::TRY:     mHandlers.push_back({ pc + in.by(), size(), syssize(), mReturns.size(), mActive }); break;
+                case Compiled::ENDTRY:  mHandlers.pop_back(); pc += in.by();      break;
+                case Compiled::INTEGER_OP: operate<Integer>(in.by());             break;
+                case Compiled::REAL_OP:    operate<Real>(in.by());                break;
+                case Compiled::GUARDED_OP:
+                    if (mUser.size() >= 2 && mUser.at(0).index() == mUser.at(1).index() && mUser.at(0).index() <= REAL) {
+                        if (mUser.at(0).index() == INTEGER) operate<Integer>(in.by());
+                        else operate<Real>(in.by());
+                    } else static_cast<Builtin*>(mOperators[in.by()])->function()(this);
+                    break;
+                case Compiled::RETURN:
+                    tick(pc - from);
+                    leave(r->caller);
+                    mReturns.pop_back();
+                    while (!mHandlers.empty() && mHandlers.back().calls > mReturns.size()) mHandlers.pop_back();
+                    if (mReturns.size() == floor) {
+                        mFloor = outer;
+                        return;
+                    }
+                    r = &mReturns.back();
+                    block = r->code->data();
+                    locals = frame();
+                    pc = from = r->pc;
+                    break;
+                }
+                if constexpr (S != NONE) {
+                    r->pc = pc;
+                    mFloor = outer;
+                    return;
+                }
+            }
+        } catch (const Error& e) {
+            if (e.preempted() || mBranchFailed || mHandlers.empty() || mHandlers.back().calls <= floor) {
+                mReturns.erase(mReturns.begin() + ptrdiff_t(floor), mReturns.end());
+                mFloor = outer;
+                throw;
+            }
+            Handler h = mHandlers.back();
+            mHandlers.pop_back();
+            // Callees that were interrupted never left their frames; the handler's activation becomes the top one again.
+            mReturns.erase(mReturns.begin() + ptrdiff_t(h.calls), mReturns.end());
+            unwind(h.self, h.user, h.system);
+            r = &mReturns.back();
+            block = r->code->data();
+            locals = frame();
+            pc = from = h.pc;
+            push(e.message());
+            push(e.code());
+            if constexpr (S != NONE) {
+                r->pc = pc;
+                mFloor = outer;
+                return;
+            }
+        }
+    }
+}
+
+void Fifth::VM::invoke(Compiled* code) {
+    if (mReturns.size() == mReturns.capacity()) throw Error(Error::FRAME_OVERFLOW, L"return stack full, calls nested too deeply");
+    Activation caller = mActive;
+    enter(code);
+    mReturns.push_back({ code, 0, caller });
+}
+
+// Runs the spawned tasks round robin until all have finished.
+void Fifth::VM::join() {
+    if (mTask != nullptr) throw Error(Error::CONTROL_MISMATCH, L"join inside a task");
+    for (; ; ) {
+        switch (round()) {
+        case IDLE:     return;
+        case PROGRESS:                                    break;
+        case SLEEPING: std::this_thread::sleep_until(mWake); break;
+        case STALLED:
+            mTasks.clear();
+            throw Error(Error::DEADLOCK, L"every task is waiting on a channel");
+        }
     }
-    return vars;
+}
+
+void Fifth::VM::leave(const Activation& caller) {
+    mFrameTop = mActive.code != nullptr ? mActive.base : 0;
+    mActive = caller;
+}
+
+Fifth::String Fifth::VM::localName(const Value* ptr) {
+    if (mActive.code == nullptr || ptr < frame() || ptr >= frame() + mActive.code->frameSize()) return L"";
+    return mActive.code->localAt(size_t(ptr - frame()));
+}
+
+size_t Fifth::VM::localSize(const Value* ptr) {
+    String name = localName(ptr);
+    return name.empty() ? 0 : mActive.code->locals()[name].size;
 }
 
 size_t Fifth::VM::pc() {
-    return mPC;
+    return mDebug != nullptr ? mReturns.back().pc : 0;
+}
+
+// A global shrinks in place, and grows in place when the slots after it are free. Otherwise it moves to the first free
+// run that is big enough, a hole left by another global or the top of the area, so compiled code (which refers to the
+// descriptor) is unaffected but addresses taken earlier are not. Raises an error when no run is big enough.
+void Fifth::VM::resize(size_t n, size_t size) {
+    Global& g = mGlobals[n];
+    size_t end = g.offset + g.size;
+    if (size <= g.size) {
+        vacate(g.offset + size, end);
+        mGlobalUsed -= g.size - size;
+        g.size = size;
+        return;
+    }
+    auto owner = mGlobalOwner.begin();
+    bool after = GlobalCapacity - g.offset >= size
+              && std::all_of(owner + ptrdiff_t(end), owner + ptrdiff_t(g.offset + size), [](uint32_t o) { return o == uint32_t(-1); });
+    size_t offset = after ? g.offset : globalRoom(size);
+    if (offset == npos) throw Error(Error::DICTIONARY_OVERFLOW, L"global area full, no room to resize " + g.name);
+    auto slots = mGlobalSlots.begin();
+    if (offset != g.offset) std::move(slots + ptrdiff_t(g.offset), slots + ptrdiff_t(end), slots + ptrdiff_t(offset));
+    std::fill(slots + ptrdiff_t(offset + g.size), slots + ptrdiff_t(offset + size), Value(0));
+    std::fill(owner + ptrdiff_t(offset), owner + ptrdiff_t(offset + size), uint32_t(n));
+    mGlobalTop = std::max(mGlobalTop, offset + size);
+    if (offset != g.offset) vacate(g.offset, end);
+    mGlobalUsed += size - g.size;
+    g.offset = offset;
+    g.size = size;
+}
+
+bool Fifth::VM::running(Code* code) {
+    auto in = [code](const std::vector<Return>& returns) {
+        return std::any_of(returns.begin(), returns.end(), [code](const Return& r) { return r.code == code; });
+    };
+    return in(mReturns) || std::any_of(mTasks.begin(), mTasks.end(), [&](const Task& t) { return in(t.returns); });
+}
+
+// Runs a task until it yields, sleeps, blocks or finishes. Returns false once it has finished, with or without an
+// error; a task's error is kept as the VM's error but does not stop the others, running out of a limit does.
+bool Fifth::VM::resume(Task& task) {
+    size_t floor = mFloor;
+    auto restore = [&] {
+        mTask = nullptr;
+        mFloor = floor;
+        mSuspend = RUNNING;
+        exchange(task);
+    };
+    exchange(task);
+    mTask = &task;
+    mFloor = npos;
+    mSuspend = RUNNING;
+    bool alive = false;
+    try {
+        if (!task.started) {
+            task.started = true;
+            mDictionary[task.word]->exec(this);
+        } else interpret<NONE>(0);
+        alive = mSuspend != RUNNING;
+    } catch (const Error& e) {
+        restore();
+        if (e.preempted()) throw;
+        mError = L"task " + task.word + L": " + e.message();
+        return false;
+    } catch (...) {
+        restore();
+        throw;
+    }
+    restore();
+    return alive;
+}
+
+// The compiled word def is about to replace, if any. Swapping a body under a word that is running would leave it at a
+// position in code it never had, so neither it nor any word compiled again because of it may be running.
+Fifth::Compiled* Fifth::VM::redefining(const String& name) {
+    Code* existing = mDictionary.contains(name) ? mDictionary[name] : nullptr;
+    bool moved = existing == nullptr || !existing->compiled();
+    std::set<String> affected = stale(name, moved);
+    if (!moved) affected.insert(name);
+    for (const auto& word: affected) {
+        if (mDictionary.contains(word) && running(mDictionary[word])) {
+            throw Error(Error::WORD_RUNNING, L"cannot redefine " + name + L" while " + word + L" is running");
+        }
+    }
+    return moved ? nullptr : static_cast<Compiled*>(existing);
+}
+
+// Compiles words again from their source, each after any of the others it refers to, so that a word copied into
+// another is up to date before it is copied. Each new body is swapped into the existing word. Words that have come to
+// copy each other through redefinitions are taken in any order.
+void Fifth::VM::recompile(std::set<String> words) {
+    while (!words.empty()) {
+        auto next = std::find_if(words.begin(), words.end(), [&](const String& w) {
+            return std::none_of(mUses[w].begin(), mUses[w].end(), [&](const String& u) { return u != w && words.contains(u); });
+        });
+        String name = next == words.end() ? *words.begin() : *next;
+        words.erase(name);
+        Code* code = mDictionary.contains(name) ? mDictionary[name] : nullptr;
+        if (code == nullptr || !code->compiled() || !mSources.contains(name)) continue;
+
+        String buffer = mBuffer;
+        bool wasCompiling = mCompiling;
+        mBuffer = mSources[name];
+        mCompiling = true;
+        Compiled* block = compileWord(this, name, static_cast<Compiled*>(code), earlier(name));
+        mBuffer = buffer;
+        mCompiling = wasCompiling;
+        if (block == nullptr) continue;
+        static_cast<Compiled*>(code)->swap(*block);
+        delete block;                                                     // NOLINT
+        remember(name);
+    }
 }
 
+// Fingerprints name as just compiled, and hands its body to the cache unless the cache has one like it.
+void Fifth::VM::remember(const String& name) {
+    uint64_t key = CompileCache::key(*this, name, mSources[name], mUses[name]);
+    mFingerprints[name] = key;
+    // A body copying or calling the definition it replaced cannot be told apart from one of the same source that
+    // recurses, so it is not cached.
+    if (mCache == nullptr || mCache->contains(key) || earlier(name) != nullptr) return;
+    if (auto entry = CompileCache::capture(*this, name, mSources[name], *static_cast<Compiled*>(mDictionary[name])); entry.has_value()) {
+        mCache->store(std::move(entry.value()));
+    }
+}
+
+// Abandons whatever was running or being compiled. The user stack is left as it was, for inspection.
+void Fifth::VM::recover(const Error& e) {
+    mError = e.message();
+    mColumnar = false;
+    mDiverging = 0;
+    mBranchFailed = false;
+    mCompiling = false;
+    mCode = nullptr;
+    mSkipping = 0;
+    mSystem.clear();
+    mDebug = nullptr;
+    mActive = {};
+    mFrameTop = 0;
+    mReturns.clear();
+    mHandlers.clear();
+    mTasks.clear();
+    mFloor = npos;
+    mSuspend = RUNNING;
+}
+
+// Gives every task one slice. Tasks spawned meanwhile wait for the next round.
+Fifth::VM::Round Fifth::VM::round() {
+    if (mTasks.empty()) return IDLE;
+    uint64_t transfers = mProgress;
+    bool moved = false, sleeping = false;
+    auto now = std::chrono::steady_clock::now();
+    mWake = std::chrono::steady_clock::time_point::max();
+    for (size_t n = mTasks.size(); n > 0; --n) {
+        Task task = std::move(mTasks.front());
+        mTasks.pop_front();
+        if (task.state != Task::SLEEPING || task.wake <= now) {
+            if (!resume(task)) {
+                moved = true;
+                continue;
+            }
+            moved |= task.state != Task::BLOCKED;
+        }
+        if (task.state == Task::SLEEPING) {
+            mWake = std::min(mWake, task.wake);
+            sleeping = true;
+        }
+        mTasks.push_back(std::move(task));
+    }
+    if (moved || mProgress != transfers) return PROGRESS;
+    return sleeping ? SLEEPING : STALLED;
+}
+
+// Starts the instruction budget and time slice over.
+void Fifth::VM::start() {
+    mRan = 0;
+    mChecks = 0;
+    if (mLimits.time.count() != 0) mDeadline = std::chrono::steady_clock::now() + mLimits.time;
+}
+
+// The words to compile again when name changes: those that copied it in and, when name is now a different word
+// altogether, all that referred to it; then whatever copied any of those in, and so on.
+std::set<Fifth::String> Fifth::VM::stale(const String& name, bool moved) {
+    std::set<String> found = moved ? mUsedBy[name] : mInlinedBy[name];
+    found.erase(name);
+    std::vector<String> pending(found.begin(), found.end());
+    while (!pending.empty()) {
+        String next = pending.back();
+        pending.pop_back();
+        for (const auto& user: mInlinedBy[next]) if (user != name && found.insert(user).second) pending.push_back(user);
+    }
+    return found;
+}
+
+// Outside a task sleeping holds up the thread.
+void Fifth::VM::sleep(std::chrono::milliseconds ms) {
+    if (!suspendable()) {
+        std::this_thread::sleep_for(ms);
+        return;
+    }
+    mSuspend = YIELDED;
+    mTask->state = Task::SLEEPING;
+    mTask->wake = std::chrono::steady_clock::now() + ms;
+}
+
+// Frees global slots, and the top of the area down to the last slot still in use.
+void Fifth::VM::vacate(size_t from, size_t to) {
+    std::fill(mGlobalSlots.begin() + ptrdiff_t(from), mGlobalSlots.begin() + ptrdiff_t(to), Value(0));
+    std::fill(mGlobalOwner.begin() + ptrdiff_t(from), mGlobalOwner.begin() + ptrdiff_t(to), uint32_t(-1));
+    while (mGlobalTop > 0 && mGlobalOwner[mGlobalTop - 1] == uint32_t(-1)) --mGlobalTop;
+}
+
+void Fifth::VM::spawn(const String& word) {
+    if (!mDictionary.contains(word)) throw Error(Error::UNDEFINED_WORD, L"undefined word: " + word);
+    mTasks.emplace_back(word);
+}
+
+// Steps until the session ends or reaches a breakpoint.
 void Fifth::VM::run() {
     for (; ; ) {
         stepInto();
-        if (mDebug == nullptr) break;
-        for (const auto& x: mBreakPoints) if (x.function == mDebug && mPC == x.pc) break;
+        if (mDebug == nullptr) return;
+        for (const auto& x: mBreakPoints) if (x.function == mDebug && pc() == x.pc) return;
     }
 }
 
+// One instruction of the session; an error that nothing catches ends it.
+void Fifth::VM::step(Step how) {
+    if (mDebug == nullptr) return;
+    try {
+        if (how == INTO) interpret<INTO>(0);
+        else interpret<OVER>(0);
+    } catch (const Error& e) {
+        recover(e);
+        return;
+    }
+    mDebug = mReturns.empty() ? nullptr : mReturns.back().code;
+}
+
 void Fifth::VM::stepInto() {
-    Compiled* code = dynamic_cast<Compiled*>(mDebug);
-    if (code->get(mPC).op() != Compiled::CALL) stepOver();
-    const auto& instr = code->get(mPC);
-    String name = nameOf(instr.code());
-    if (!name.empty() && dynamic_cast<Compiled*>(instr.code()) != nullptr) {
-        mDebugStack.emplace_back(mDebug, mPC);
-        debug(name);
-    } else stepOver();
+    step(INTO);
 }
 
 void Fifth::VM::stepOver() {
-    Compiled* code = dynamic_cast<Compiled*>(mDebug);
-    switch (code->get(mPC).op()) {
-    case Compiled::NOP:                                                    break;
-    case Compiled::PUSH:    push(code->get(mPC).value());                  break;
-    case Compiled::SYSPUSH: syspush(code->get(mPC).value());               break;
-    case Compiled::POP:     pop();                                         break;
-    case Compiled::SYSPOP:  syspop();                                      break;
-    case Compiled::CALL:    code->get(mPC).code()->exec(this);             break;
-    case Compiled::JUMP:    mPC += code->get(mPC).by();                    break;
-    case Compiled::BRANCH:  if (isTrue(pop())) mPC += code->get(mPC).by(); break;
-    case Compiled::RETURN:
-        if (mDebugStack.empty()) {
-            mDebug = nullptr;
-            return;
-        }
-        mDebug = mDebugStack.back().function;
-        mPC = mDebugStack.back().pc;
-        break;
-    }
-    ++mPC;
+    step(OVER);
 }
 
-std::vector<std::wstring> Fifth::VM::user() {
-    std::vector<std::wstring> values;
-    Compiled* code = dynamic_cast<Compiled*>(mDebug);
-    for (auto& x: mUser) values.push_back(toString(this, code, x));
-    return values;
+void Fifth::VM::unwind(const Activation& to, size_t user, size_t system) {
+    mActive = to;
+    mFrameTop = to.base + to.code->frameSize();
+    mUser.truncate(user);
+    mSystem.truncate(system);
 }
 
-std::vector<std::wstring> Fifth::VM::system() {
-    std::vector<std::wstring> values;
-    Compiled* code = dynamic_cast<Compiled*>(mDebug);
-    for (auto& x: mSystem) values.push_back(toString(this, code, x));
-    return values;
+void Fifth::VM::yield() {
+    if (!suspendable()) return;
+    mSuspend = YIELDED;
+    mTask->state = Task::READY;
 }
 
 std::optional<Fifth::Value> Fifth::VM::word(bool reload) {
@@ -1282,17 +3509,123 @@ std::wstring Fifth::VM::debugUserStack() {
 }
 
 void Fifth::Compiled::exec(VM* vm) {
-    for (size_t pc = 0; ; ++pc) {
-        switch (mBlock[pc].op()) {
-        case NOP:                                                   break;
-        case PUSH:    vm->push(mBlock[pc].value());                 break;
-        case SYSPUSH: vm->syspush(mBlock[pc].value());              break;
-        case POP:     vm->pop();                                    break;
-        case SYSPOP:  vm->syspop();                                 break;
-        case CALL:    mBlock[pc].code()->exec(vm);                  break;
-        case JUMP:    pc += mBlock[pc].by();                        break;
-        case BRANCH:  if (isTrue(vm->pop())) pc += mBlock[pc].by(); break;
-        case RETURN:                                                return;
+    vm->call(this);
+}
+
+// Copies the body, less its RETURN, onto the end of this one. Jumps are relative, so they still land inside it.
+void Fifth::Compiled::append(const Compiled& callee) {
+    mBlock.insert(mBlock.end(), callee.mBlock.begin(), callee.mBlock.end() - 1);
+}
+
+// A word of its own with this body, calling itself where this calls this.
+Fifth::Compiled* Fifth::Compiled::copy() {
+    auto* twin = new Compiled();                                          // NOLINT
+    twin->mBlock = mBlock;
+    for (auto& in: twin->mBlock) if (in.op() == CALL && in.code() == this) in = Instruction(CALL, twin);
+    twin->copyLocals(*this);
+    return twin;
+}
+
+Fifth::Compiled::Operator Fifth::Compiled::operatorOf(const String& name) {
+    static const std::map<String, Operator> operators = {
+        { L"+", ADD }, { L"-", SUBTRACT }, { L"*", MULTIPLY }, { L"<", LESS }, { L"<=", LESS_EQUAL }, { L">", GREATER },
+        { L">=", GREATER_EQUAL }, { L"=", EQUAL }, { L"<>", NOT_EQUAL }, { L"!=", NOT_EQUAL }
+    };
+    auto at = operators.find(name);
+    return at == operators.end() ? OPERATORS : at->second;
+}
+
+// Follows what the word leaves on the stack as far as it can tell, from its literals, dup, swap and pop and the
+// arithmetic itself, and replaces calls to the numeric builtins with opcodes. Where both operands are known integers,
+// or both known reals, the opcode skips the type checks; elsewhere it checks first. What is known is forgotten where a
+// jump lands and after any call whose effect on the stack it cannot tell.
+void Fifth::Compiled::specialize(VM* vm) {
+    enum Known { ANY, INTEGRAL, FLOATING };
+    std::vector<bool> target(mBlock.size(), false);
+    for (size_t pc = 0; pc < mBlock.size(); ++pc) {
+        opCode op = mBlock[pc].op();
+        if (op != JUMP && op != BRANCH && op != TRY && op != ENDTRY) continue;
+        if (ptrdiff_t to = ptrdiff_t(pc) + 1 + mBlock[pc].by(); to >= 0 && size_t(to) < mBlock.size()) target[size_t(to)] = true;
+    }
+
+    std::vector<Known> stack;
+    auto pop = [&stack]() {
+        if (stack.empty()) return ANY;
+        Known k = stack.back();
+        stack.pop_back();
+        return k;
+    };
+    for (size_t pc = 0; pc < mBlock.size(); ++pc) {
+        if (target[pc]) stack.clear();
+        const Instruction in = mBlock[pc];
+        int op = OPERATORS;
+        switch (in.op()) {
+        case PUSH:
+            stack.push_back(in.value().index() == INTEGER ? INTEGRAL : in.value().index() == REAL ? FLOATING : ANY);
+            break;
+        case LOCAL:
+        case GLOBAL:     stack.push_back(ANY); break;
+        case POP:
+        case BRANCH:     pop();                break;
+        case INTEGER_OP:
+        case REAL_OP:
+        case GUARDED_OP: op = in.by();         break;
+        case CALL:
+            if (Code* code = in.code(); code->compiled()) stack.clear();
+            else if (String name = vm->nameOf(code); name == L"dup") {
+                Known k = pop();
+                stack.insert(stack.end(), { k, k });
+            } else if (name == L"swap") {
+                Known right = pop();
+                Known left = pop();
+                stack.insert(stack.end(), { right, left });
+            } else if (name == L"pop") pop();
+            else if (op = operatorOf(name); op == OPERATORS || vm->operatorCode(op) != code) {
+                op = OPERATORS;
+                stack.clear();
+            }
+            break;
+        case SYSPUSH:
+        case SYSPOP:
+        case NOP:                              break;
+        default:         stack.clear();        break;
         }
+        if (op == OPERATORS) continue;
+
+        Known right = pop();
+        Known left = pop();
+        bool numeric = left == right && left != ANY;
+        rewrite(pc, numeric ? (left == INTEGRAL ? INTEGER_OP : REAL_OP) : GUARDED_OP, op);
+        // A comparison gives an integer; integer arithmetic that overflows gives a big integer, so only reals stay known.
+        if (op >= LESS) stack.push_back(numeric ? INTEGRAL : ANY);
+        else stack.push_back(numeric && left == FLOATING ? FLOATING : ANY);
     }
 }
+
+// Takes the word's stack shuffles apart in register form and puts it back as stack code, see RegisterForm: shuffles
+// that undo each other or only throw away what was just pushed are dropped, a copy of a literal, local or global is
+// pushed again, and what is left is done in as few instructions as can be found.
+void Fifth::Compiled::simplify(VM* vm) {
+    RegisterForm form(vm, mBlock);
+    form.propagate();
+    form.prune();
+    mBlock = form.raise();
+}
+
+Fifth::String Fifth::Compiled::symbol(int op) {
+    static const wchar_t* symbols[OPERATORS] = { L"+", L"-", L"*", L"<", L"<=", L">", L">=", L"=", L"<>" };    // NOLINT
+    return symbols[op];                                                                                            // NOLINT
+}
+
+// Short, no locals of its own, no try, one RETURN at the end, and does not call itself.
+bool Fifth::Compiled::inlinable() const {
+    if (mBlock.empty() || mBlock.size() > InlineLimit + 1 || frameSize() != 0 || mBlock.back().op() != RETURN) return false;
+    for (size_t n = 0; n + 1 < mBlock.size(); ++n) {
+        switch (mBlock[n].op()) {
+        case RETURN: case TRY: case ENDTRY: return false;
+        case CALL: if (mBlock[n].code() == this) return false; break;
+        default: break;
+        }
+    }
+    return true;
+}
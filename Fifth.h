@@ -1,65 +1,175 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <span>
 #include <string>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
 namespace Fifth {
 
 typedef    long long Integer;
+// double keeps Values small and real arithmetic in SSE registers. FIFTH_EXTENDED_REAL, the CMake option of that name,
+// makes it long double for extended precision at the cost of both.
+#ifdef FIFTH_EXTENDED_REAL
 typedef  long double Real;
+#else
+typedef       double Real;
+#endif
 typedef std::wstring String;
+class CompileCache;
 class Stack;
 class Table;
 class Vector;
 class External;
 
-typedef std::variant<Integer, Real, String, External*, Table*, void*> Value;
-enum Type { INTEGER, REAL, STRING, EXTERNAL, TABLE, VALUEPTR };
+typedef std::variant<Integer, Real, String, External*, Table*, void*, Vector*> Value;
+enum Type { INTEGER, REAL, STRING, EXTERNAL, TABLE, VALUEPTR, VECTOR };
 
 static constexpr  int IMMEDIATE   = 0b00000001;
 static constexpr  int COMPILETIME = 0b00000010;
+static constexpr  int COMPILED    = 0b00000100;  // set by Compiled itself, so the interpreter can tell without a cast
 static constexpr bool RELOAD      = true;
 
+// Stable across runs and platforms with the same wchar_t width, unlike std::hash.
+size_t hash(const Value& v);
+
+// Open-addressing table: one control byte per slot (empty, deleted or a 7 bit hash tag) probed eight at a time,
+// pointing into entry storage that never moves, so pointers handed out by [] stay valid until the key is erased.
+// Live entries are also linked in insertion order, which is the order a hash table walks in, whatever slots erased
+// entries left free. An ordered table keeps the same entry storage but indexes it with a B+tree instead, so walks are in key order.
 class Table {
+public:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    struct Entry {
+         Value first;
+         Value second;
+        size_t hash = 0;
+          bool live = false;
+      uint32_t prev = None;  // the entries inserted just before and after this one
+      uint32_t next = None;
+    };
+
 private:
-    std::unordered_map<Value, Value> mValue;
+    struct Node {
+                                      bool leaf = true;
+                        std::vector<Value> keys;
+                     std::vector<uint32_t> entries;  // leaves: entry numbers, parallel to keys
+        std::vector<std::unique_ptr<Node>> children; // interior nodes: keys.size() + 1 of them
+                                     Node* next = nullptr;
+                                     Node* prev = nullptr;
+    };
 
 public:
-    Table() {}
+    class iterator {
+    private:
+             Table* mTable;
+           uint32_t mAt;
+        const Node* mLeaf;
+             size_t mPos;
+
+        void skip() {
+            while (mLeaf != nullptr && mPos >= mLeaf->keys.size()) { mLeaf = mLeaf->next; mPos = 0; }
+        }
 
-    Value& operator[](const Value& x) { return mValue[x]; }
+    public:
+        iterator(Table* table, uint32_t at, const Node* leaf = nullptr, size_t pos = 0)
+            : mTable(table)
+            , mAt(at)
+            , mLeaf(leaf)
+            , mPos(pos)
+        { skip(); }
+
+           Entry& operator*() const                  { return mTable->mEntries[mLeaf != nullptr ? mLeaf->entries[mPos] : mAt]; }
+           Entry* operator->() const                 { return &**this; }
+        iterator& operator++()                       { if (mLeaf != nullptr) ++mPos; else mAt = (**this).next; skip(); return *this; }
+             bool operator==(const iterator& x) const { return mAt == x.mAt && mLeaf == x.mLeaf && mPos == x.mPos; }
+    };
 
-    auto begin() { return mValue.begin(); }
-    auto end()   { return mValue.end(); }
-
-      Table* append(const Table* m) { mValue.insert(m->mValue.begin(), m->mValue.end()); return this; }
-        void clear()                { mValue.clear(); }
-        bool contains(Value x )     { return mValue.contains(x); }
-      Table* erase(Value x)         { if (mValue.contains(x)) { mValue.erase(mValue.find(x)); } return this; }
-      size_t size() const           { return mValue.size(); }
-        bool empty()                { return mValue.empty(); }
+private:
+       std::vector<uint8_t> mControl;
+      std::vector<uint32_t> mIndex;
+          std::deque<Entry> mEntries;
+      std::vector<uint32_t> mFree;
+                   uint32_t mOldest = None;
+                   uint32_t mNewest = None;
+                     size_t mSize = 0;
+                     size_t mDeleted = 0;
+      std::unique_ptr<Node> mRoot;
+                      Node* mHead = nullptr;
+                      Node* mTail = nullptr;
+
+      uint32_t allocate(const Value& x, size_t h);
+          void insert(const Value& x, uint32_t at);
+    static std::unique_ptr<Node> insertInto(Node* n, const Value& x, uint32_t at, Value& separator, Node*& tail);
+     uint32_t* lookup(const Value& x) const;
+    const Node* lowerBound(const Value& x, size_t& pos) const;
+          void release(uint32_t at);
+        size_t slotOf(const Value& x, size_t h) const;
+          void rehash(size_t capacity);
+    static std::unique_ptr<Node> split(Node* n, bool appended, Value& separator, Node*& tail);
+
+public:
+    Table(bool ordered = false);
+
+    Value& operator[](const Value& x);
+
+    iterator begin() { return mRoot ? iterator(this, None, mHead) : iterator(this, mOldest); }
+    iterator end()   { return { this, None }; }
+
+      Table* append(const Table* m);
+        void clear();
+        bool contains(const Value& x) const;
+      Table* erase(const Value& x);
+      Value* find(const Value& x);
+      Entry* first();
+      Entry* last();
+        bool ordered() const              { return mRoot != nullptr; }
+      Table* range(const Value& lo, const Value& hi);
+      size_t size() const                 { return mSize; }
+        bool empty()                      { return mSize == 0; }
 };
 
+// Contiguous values. Storage grows geometrically, so building a vector one push at a time is amortized O(1) per element.
 class Vector {
 private:
     std::vector<Value> mValue;
 
 public:
     Vector() { }
+    Vector(std::vector<Value>::const_iterator from, std::vector<Value>::const_iterator to)
+        : mValue(from, to)
+    { }
 
     Value& operator[](Integer x) { return mValue[x]; }
 
+    auto begin() const { return mValue.begin(); }
+    auto end() const   { return mValue.end(); }
+
        void append(Value v)         { mValue.push_back(v); }
     Vector* append(const Vector* v) { mValue.insert(mValue.end(), v->mValue.begin(), v->mValue.end()); return this; }
+      Value at(Integer x) const     { return x >= 0 && size_t(x) < mValue.size() ? mValue[x] : Value(0); }
        void clear()                 { mValue.clear(); }
-       bool empty()                 { return mValue.empty(); }
-       void pop()                   { mValue.pop_back(); }
+       bool empty() const           { return mValue.empty(); }
+      Value pop()                   { if (mValue.empty()) return 0; Value v = mValue.back(); mValue.pop_back(); return v; }
        void push_back(Value v)      { mValue.push_back(v); }
-     size_t size()                  { return mValue.size(); }
+       void reserve(size_t n)       { mValue.reserve(n); }
+     size_t size() const            { return mValue.size(); }
+
+    Vector* slice(Integer from, Integer to) const;
+       void sort();
 };
 
 class VM;
@@ -70,27 +180,175 @@ class VM;
 
 class External {
 public:
+    // The operators the builtins hand on when an External is on the left. The first eight follow Simd::Op.
+    enum Operator { ADD, SUBTRACT, MULTIPLY, DIVIDE, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, MODULO, POWER,
+                    EQUAL, NOT_EQUAL, AND, OR, OPERATORS };
+
     External() { }
     virtual ~External() { }
 
     NO(External);
 
+    static const wchar_t* symbol(Operator op);
+
       virtual bool empty()                                      { return true; }
       virtual void install(VM*)                                 { } // <-- handles installing this External type words.
+      // Applies op with right to this External in place. Types that still override send() get the operator's symbol.
+      virtual void operate(VM* vm, Operator op, const Value& right) { send(vm, symbol(op), right); }
       virtual void send(VM*, const std::wstring&, const Value&) { }
       virtual Real toReal()                                     { return 0.0; }
     virtual String toString()                                   { return L"External"; }
    virtual Integer toInteger()                                  { return 0; }
 };
 
+class TypedArray: public External {
+public:
+    enum Kind { INT64, FLOAT64 };
+
+private:
+                    Kind mKind;
+    std::vector<Integer> mIntegers;
+     std::vector<double> mReals;
+
+public:
+    TypedArray(Kind kind, size_t size)
+        : mKind(kind)
+    { if (kind == INT64) mIntegers.resize(size); else mReals.resize(size); }
+
+     Integer* integers()           { return mIntegers.data(); }
+         Kind kind() const         { return mKind; }
+      double* reals()              { return mReals.data(); }
+       size_t size() const         { return mKind == INT64 ? mIntegers.size() : mReals.size(); }
+
+                  Value at(size_t i) const;
+                   void fill(const Value& v);
+            TypedArray* gather(const std::vector<size_t>& rows) const;
+                   void put(size_t i, const Value& v);
+    std::vector<size_t> where(bool set) const;
+
+         bool empty() override      { return size() == 0; }
+         void operate(VM* vm, Operator op, const Value& right) override;
+         Real toReal() override     { return Real(size()); }
+       String toString() override;
+      Integer toInteger() override  { return Integer(size()); }
+
+private:
+         void toIntegers();
+         void toReals();
+};
+
+// What [] gives for a vector element: the vector and a position, not an address into storage that moves when the
+// vector grows. get, <- and -> look the element up again each time, and fail once the vector has shrunk past it.
+class Element: public External {
+private:
+    Vector* mVector;
+    Integer mAt;
+
+public:
+    Element(Vector* vector, Integer at)
+        : mVector(vector)
+        , mAt(at)
+    { }
+
+      Integer at() const            { return mAt; }
+        Value* value() const        { return mAt >= 0 && size_t(mAt) < mVector->size() ? &(*mVector)[mAt] : nullptr; }
+
+         Real toReal() override;
+       String toString() override;
+      Integer toInteger() override;
+};
+
+// A bounded queue between tasks. It may be shared by VMs on different threads, but only numbers and strings should
+// cross between VMs that way; tables and vectors belong to the VM that made them.
+class Channel: public External {
+private:
+          size_t mCapacity;
+    std::mutex mMutex;
+    std::deque<Value> mValues;
+
+public:
+    Channel(size_t capacity)
+        : mCapacity(std::max(capacity, size_t(1)))
+    { }
+
+          size_t capacity() const   { return mCapacity; }
+            bool put(const Value& v) {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (mValues.size() == mCapacity) return false;
+                mValues.push_back(v);
+                return true;
+            }
+          size_t size()             { std::lock_guard<std::mutex> lock(mMutex); return mValues.size(); }
+    std::optional<Value> take() {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (mValues.empty()) return std::nullopt;
+                Value v = std::move(mValues.front());
+                mValues.pop_front();
+                return v;
+            }
+
+            bool empty() override      { return size() == 0; }
+            Real toReal() override     { return Real(size()); }
+          String toString() override   { return L"Channel(" + std::to_wstring(size()) + L"/" + std::to_wstring(mCapacity) + L")"; }
+         Integer toInteger() override  { return Integer(size()); }
+};
+
+// Raised when a script cannot go on. Scripts catch it with try ... catch ... endtry; otherwise VM::execute does,
+// recovers and reports failure. The built in codes follow the ANS Forth THROW codes, scripts throw their own.
+// Hitting a VM limit preempts the script: no handler can catch that.
+class Error {
+public:
+    enum Code {
+        ABORTED             = -1,
+        STACK_OVERFLOW      = -3,
+        STACK_UNDERFLOW     = -4,
+        FRAME_OVERFLOW      = -5,
+        DICTIONARY_OVERFLOW = -8,
+        INVALID_ADDRESS     = -9,
+        DIVIDE_BY_ZERO      = -10,
+        TYPE_MISMATCH       = -12,
+        UNDEFINED_WORD      = -13,
+        CONTROL_MISMATCH    = -22,
+        BAD_NUMBER          = -24,
+
+        INSTRUCTION_LIMIT = -256,
+        TIME_LIMIT        = -257,
+        DEPTH_LIMIT       = -258,
+        MEMORY_LIMIT      = -259,
+        DEADLOCK          = -260,
+        WORD_RUNNING      = -261,
+    };
+
+private:
+    Integer mCode;
+     String mMessage;
+
+public:
+    Error(Integer code, const String& message)
+        : mCode(code)
+        , mMessage(message)
+    { }
+
+          Integer code() const      { return mCode; }
+    const String& message() const   { return mMessage; }
+             bool preempted() const { return mCode <= INSTRUCTION_LIMIT && mCode >= MEMORY_LIMIT; }
+};
+
+// Parses straight to Real, so that a literal is rounded once.
+inline Real parseReal(const String& s, size_t* pos = nullptr) {
+    if constexpr (std::is_same_v<Real, double>) return std::stod(s, pos);
+    else return std::stold(s, pos);
+}
+
 inline Integer asInteger(const Value& v) {
     switch (v.index()) {
     case INTEGER:  return std::get<Integer>(v);
     case REAL:     return std::get<Real>(v);                       // NOLINT
-    case STRING:   return std::stoll(std::get<String>(v));         // NOLINT
+    case STRING:   try { return std::stoll(std::get<String>(v)); } catch (...) { throw Error(Error::BAD_NUMBER, L"not a number: " + std::get<String>(v)); }
     case EXTERNAL: return std::get<External*>(v)->toInteger();     // NOLINT
     case TABLE:    return std::get<Table*>(v)->size();             // NOLINT
     case VALUEPTR: return asInteger(*(Value*) std::get<void*>(v)); // NOLINT
+    case VECTOR:   return std::get<Vector*>(v)->size();            // NOLINT
     }
     return 0;
 }
@@ -99,10 +357,11 @@ inline Real asReal(const Value& v) {
     switch (v.index()) {
     case INTEGER:  return std::get<Integer>(v);
     case REAL:     return std::get<Real>(v);                       // NOLINT
-    case STRING:   return std::stold(std::get<String>(v));         // NOLINT
+    case STRING:   try { return parseReal(std::get<String>(v)); } catch (...) { throw Error(Error::BAD_NUMBER, L"not a number: " + std::get<String>(v)); }
     case EXTERNAL: return std::get<External*>(v)->toInteger();     // NOLINT
     case TABLE:    return std::get<Table*>(v)->size();             // NOLINT
     case VALUEPTR: return asReal(*(Value*) std::get<void*>(v));    // NOLINT
+    case VECTOR:   return std::get<Vector*>(v)->size();            // NOLINT
     }
     return 0;
 }
@@ -121,6 +380,14 @@ inline std::wstring asString(const Value& v) {
             answer += L"}";
             return answer;
         }
+    case VECTOR: {
+            static constexpr size_t Shown = 16;
+            String answer = L"[";
+            Vector* vec = std::get<Vector*>(v);
+            for (size_t i = 0; i < vec->size() && i < Shown; ++i) answer += (i ? L", " : L"") + asString(vec->at(Integer(i)));
+            if (vec->size() > Shown) answer += L", ...";
+            return answer + L"]";
+        }
     }
     return L"";
 }
@@ -133,40 +400,62 @@ inline bool isTrue(const Value& v) {
     case EXTERNAL: return !std::get<External*>(v)->empty();
     case TABLE:    return !std::get<Table*>(v)->empty();
     case VALUEPTR: return isTrue(*(Value*) std::get<void*>(v)); // NOLINT
+    case VECTOR:   return !std::get<Vector*>(v)->empty();
     }
     return false;
 }
 
+// Storage is allocated once, at the capacity given; pushing past it or popping an empty stack raises an Error.
 class Stack {
 private:
     std::vector<Value> mValue;
+                String mName;
+                size_t mSize = 0;
 
 public:
-    Stack() { }
+    static constexpr size_t DefaultCapacity = 65536;
+
+    Stack(const String& name, size_t capacity = DefaultCapacity)
+        : mValue(capacity)
+        , mName(name)
+    { }
 
     auto begin() { return mValue.begin(); }
-    auto end()   { return mValue.end(); }
-
-    Stack* append(Stack* s)     { mValue.insert(mValue.end(), s->mValue.begin(), s->mValue.end()); return this; }
-      void dup()                { nth(0); }
-      bool empty()              { return mValue.empty(); }
-      bool isEmpty()            { return empty(); }
-      void nth(Integer n)       { push(mValue[size() - (n + 1)]); }
-      void over()               { nth(1); }
-     Value pop()                { Value v = mValue.back(); mValue.pop_back(); return v; }
-      void push(const Value& v) { mValue.push_back(v); }
-      void rot()                { Value a = pop();  Value b = pop(); Value c = pop(); push(b); push(a); push(c); }
-      void rrot()               { Value a = pop();  Value b = pop(); Value c = pop(); push(a); push(c); push(b); }
-    size_t size()               { return mValue.size(); }
-      void swap()               { Value a = pop(); Value b = pop(); push(a); push(b); } // NOLINT
-     Value top()                { return mValue.back(); }
+    auto end()   { return mValue.begin() + ptrdiff_t(mSize); }
+
+    const Value& at(size_t n) const { need(n + 1); return mValue[mSize - (n + 1)]; }
+          size_t capacity() const   { return mValue.size(); }
+            void clear()            { truncate(0); }
+            void dup()              { nth(0); }
+            bool empty()            { return mSize == 0; }
+            bool isEmpty()          { return empty(); }
+            void need(size_t n) const { if (mSize < n) throw Error(Error::STACK_UNDERFLOW, mName + L" stack underflow"); }
+            void nth(Integer n)     { push(at(size_t(n))); }
+            void over()             { nth(1); }
+           Value pop()              { need(1); return std::move(mValue[--mSize]); }
+            void push(const Value& v) {
+                if (mSize == mValue.size()) throw Error(Error::STACK_OVERFLOW, mName + L" stack overflow");
+                mValue[mSize++] = v;
+            }
+            void rot()              { need(3); std::rotate(end() - 3, end() - 2, end()); }
+            void rrot()             { need(3); std::rotate(end() - 3, end() - 1, end()); }
+          size_t size()             { return mSize; }
+            void swap()             { need(2); std::swap(mValue[mSize - 1], mValue[mSize - 2]); }
+           Value top()              { need(1); return mValue[mSize - 1]; }
+            void truncate(size_t n) { while (mSize > n) mValue[--mSize] = 0; }
 };
 
 class Code {
+public:
+    struct Local {
+        size_t offset;
+        size_t size;
+    };
+
 private:
-                                     int mFlags;
-    std::map<String, std::vector<Value>> mLocals;
-                std::map<Value*, String> mReverse;
+                         int mFlags;
+    std::map<String, Local> mLocals;
+                      size_t mFrameSize = 0;
 
 public:
     Code(int flags = 0)
@@ -176,13 +465,21 @@ public:
     NO(Code);
 
      bool compileTime() const   { return mFlags & COMPILETIME; }
+     bool compiled() const      { return mFlags & COMPILED; }
+   size_t frameSize() const     { return mFrameSize; }
      bool immediate() const     { return mFlags & IMMEDIATE; }
      bool isCompileTime() const { return compileTime(); }
      bool isImmediate() const   { return immediate(); }
     auto& locals()              { return mLocals; }
-    auto& reverse()             { return mReverse; }
+
+   size_t declare(const String& name, size_t size = 1);
+   String localAt(size_t offset) const;
 
     virtual void exec(VM*) = 0;
+
+protected:
+     void copyLocals(const Code& other) { mLocals = other.mLocals; mFrameSize = other.mFrameSize; }
+     void swapLocals(Code& other) { std::swap(mLocals, other.mLocals); std::swap(mFrameSize, other.mFrameSize); }
 };
 
 typedef std::function<void(VM*)> Lambda;
@@ -197,12 +494,18 @@ public:
         , mFunction(function)
     { }
 
+    const Lambda& function() const { return mFunction; }
+
     void exec(VM* vm) override { mFunction(vm); }
 };
 
 class Compiled: public Code {
 public:
-    enum opCode { NOP, PUSH, SYSPUSH, POP, SYSPOP, CALL, JUMP, BRANCH, RETURN };
+    enum opCode { NOP, PUSH, SYSPUSH, POP, SYSPOP, CALL, JUMP, BRANCH, RETURN, LOCAL, GLOBAL, TRY, ENDTRY,
+                  INTEGER_OP, REAL_OP, GUARDED_OP };
+    // What the numeric opcodes do; INTEGER_OP and REAL_OP trust def that both operands have that type, GUARDED_OP checks
+    // and calls the builtin when they differ or are not numbers.
+    enum Operator { ADD, SUBTRACT, MULTIPLY, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, EQUAL, NOT_EQUAL, OPERATORS };
     class Instruction {
         opCode mOpCode;
         std::variant<std::nullptr_t, int, Code*, Value> mArgument;
@@ -236,16 +539,34 @@ private:
     std::vector<Instruction> mBlock;
 
 public:
+    // Longest body, not counting its RETURN, that def copies into a caller instead of calling.
+    static constexpr size_t InlineLimit = 8;
+
     Compiled()
-        : Code()
+        : Code(COMPILED)
     { }
 
     void exec(VM* vm) override;
 
+           void append(const Compiled& callee);
+      Compiled* copy();
+           bool inlinable() const;
+    static Operator operatorOf(const String& name);
+           void rewrite(size_t loc, opCode op, int by) { mBlock[loc] = Instruction(op, by); }
+           void simplify(VM* vm);
+           void specialize(VM* vm);
+    static String symbol(int op);
+           void swap(Compiled& other)          { std::swap(mBlock, other.mBlock); swapLocals(other); }
+
                 size_t branch(int x)           { mBlock.emplace_back(BRANCH, x);  return location(); }
                 size_t call(Code* c)           { mBlock.emplace_back(CALL, c);    return location(); }
+    const Instruction* data() const            { return mBlock.data(); }
+                size_t endTry(int x)           { mBlock.emplace_back(ENDTRY, x);  return location(); }
     const Instruction& get(size_t x)           { return mBlock[x]; }
+                size_t global(size_t n)        { mBlock.emplace_back(GLOBAL, int(n)); return location(); }
+                size_t instruction(const Instruction& in) { mBlock.push_back(in); return location(); }
                 size_t jump(int x)             { mBlock.emplace_back(JUMP, x);    return location(); }
+                size_t local(size_t slot)      { mBlock.emplace_back(LOCAL, int(slot)); return location(); }
                 size_t location()              { return size() - 1; }
                 size_t pop()                   { mBlock.emplace_back(POP);        return location(); }
                 size_t push(const Value& v)    { mBlock.emplace_back(PUSH, v);    return location(); }
@@ -253,11 +574,92 @@ public:
                 size_t size()                  { return mBlock.size(); }
                 size_t syspop()                { mBlock.emplace_back(SYSPOP);     return location(); }
                 size_t syspush(const Value& v) { mBlock.emplace_back(SYSPUSH, v); return location(); }
+                size_t tryBlock(int x)         { mBlock.emplace_back(TRY, x);     return location(); }
                   void update(int loc, int by) { mBlock[loc].setBy(by); }
 };
 
 class VM {
+public:
+    // The running word and where its locals start in the frame area.
+    struct Activation {
+         Code* code = nullptr;
+        size_t base = 0;
+        size_t depth = 0;
+    };
+
+    // Per VM quotas, zero meaning no limit. Instructions and time are per execute(), heap bytes count what the VM's
+    // tables, vectors and arrays have taken over its lifetime; a repeated string may not outgrow what is left.
+    struct Limits {
+                     uint64_t instructions = 0;
+                       size_t depth = 0;
+                       size_t heap = 0;
+    std::chrono::milliseconds time { 0 };
+    };
+
+    // A global variable or array: its slots in the global area.
+    struct Global {
+        String name;
+        size_t offset;
+        size_t size;
+    };
+
+    // A call in progress: the word, where it carries on and the activation to go back to when it returns.
+    struct Return {
+         Compiled* code;
+            size_t pc;
+        Activation caller;
+    };
+
+    // An active try: where its catch starts, the stack depths to unwind to and the call it belongs to.
+    struct Handler {
+            size_t pc;
+            size_t user;
+            size_t system;
+            size_t calls;
+        Activation self;
+    };
+
+    // A coroutine running a word, with stacks, frames and calls of its own that are swapped into the VM while it runs.
+    // Tasks share the VM's dictionary and globals.
+    struct Task {
+        enum State { READY, SLEEPING, BLOCKED };
+
+                                   String word;
+                                    Stack user;
+                                    Stack system;
+                       std::vector<Value> frames;
+                                   size_t frameTop = 0;
+                               Activation active;
+                      std::vector<Return> returns;
+                     std::vector<Handler> handlers;
+                                     bool started = false;
+                                    State state = READY;
+    std::chrono::steady_clock::time_point wake;
+
+        Task(const String& w);
+    };
+
+    // What a round over the tasks came to; STALLED means every task is blocked and none can free another.
+    enum Round { IDLE, PROGRESS, SLEEPING, STALLED };
+
+    // A row of input for runBatch(), bottom of the stack first, and where each row's outcome goes: its index, the user
+    // stack the word left, bottom first, and the error that stopped it if one did. The stack is only valid in the call.
+    typedef std::vector<Value> Row;
+    typedef std::function<void(size_t row, std::span<const Value> stack, const Error* error)> Sink;
+
+    static constexpr size_t FrameCapacity  = 16384;
+    static constexpr size_t GlobalCapacity = 65536;
+    static constexpr size_t TaskCapacity   = 256;   // each of a task's stacks, its frame area and its calls
+    static constexpr size_t DivergeLimit   = 256;   // columnar branches that may be open at once, see diverge()
+    static constexpr size_t npos           = size_t(-1);
+
 private:
+    // Why a task's interpreter loop let go: it yielded or slept, or has to retry the builtin that just ran.
+    enum Suspend { RUNNING, YIELDED, RETRY };
+
+    // How far interpret() goes: until its call returns, or a single instruction, stepping into or over calls.
+    enum Step { NONE, INTO, OVER };
+
     struct At {
          Code* function;
         size_t pc;
@@ -269,82 +671,185 @@ private:
     };
 
                          std::vector<At> mBreakPoints;
-                         std::vector<At> mDebugStack;
                                   String mBuffer;
+                           CompileCache* mCache = nullptr;
                                    Code* mCode = nullptr;
                                     bool mCompiling = false;
-                                   Code* mDebug = nullptr;
+                                    bool mColumnar = false;     // in runColumns(), see diverge()
+                                    bool mBranchFailed = false; // an error in a columnar branch, no handler may catch it
+                                  String mError;
+                              Activation mActive;
+                                  size_t mChecks = 0;
+                                  size_t mDiverging = 0;
+           std::chrono::steady_clock::time_point mDeadline;
+                                   Code* mDebug = nullptr;        // the word being stepped through, innermost first
                  std::map<String, Code*> mDictionary;
+                 std::map<String, Code*> mEarlier;       // word -> the definition it replaced, if its body uses its own name
+              std::map<String, uint64_t> mFingerprints;  // what each word was compiled from, see CompileCache
+                                  size_t mFloor = npos;
+                      std::vector<Value> mFrames;     // sized once, so pointers to locals stay valid while their word runs
+                                  size_t mFrameTop = 0;
+                                  size_t mHeap = 0;
+                                  Limits mLimits;
                  std::map<Code*, String> mNameOf;
-    std::map<String, std::vector<Value>> mGlobals;
-                                  size_t mPC = 0;;
-                std::map<Value*, String> mReverse;
+  std::array<Code*, Compiled::OPERATORS> mOperators{};  // the builtins numeric opcodes stand in for
+                     std::vector<Global> mGlobals;
+                    std::vector<Handler> mHandlers;
+       std::map<String, std::set<String>> mInlinedBy;   // word -> the words def copied it into
+                std::map<String, size_t> mGlobalNames;
+                   std::vector<uint32_t> mGlobalOwner;  // descriptor of every global slot, so an address finds its variable in O(1)
+                      std::vector<Value> mGlobalSlots;  // sized once, like mFrames
+                                  size_t mGlobalTop = 0;
+                                  size_t mGlobalUsed = 0;       // slots below mGlobalTop that belong to a global; the rest are holes
+                                uint64_t mProgress = 0;         // channel transfers, so a round can tell it moved
+                                uint64_t mRan = 0;
+                        std::set<String> mReferred;     // names algebra refers to in the word being compiled
+                     std::vector<Return> mReturns;      // reserved once, like mFrames
                                      int mSkipping = 0;
                                    Stack mSystem;
+                std::map<String, String> mSources;      // what def read for each word, to compile it again
+       std::map<String, std::set<String>> mUsedBy;      // word -> the words that refer to it
+       std::map<String, std::set<String>> mUses;        // word -> the names it refers to
+                                   Task* mTask = nullptr;
+                        std::deque<Task> mTasks;
                                    Stack mUser;
+                                 Suspend mSuspend = RUNNING;
+           std::chrono::steady_clock::time_point mWake;
 
                     std::map<Value, int> mPrecedence;
 
 public:
-    VM();
+    VM(size_t user = Stack::DefaultCapacity, size_t system = Stack::DefaultCapacity);
 
+       void allocated(size_t bytes)          { roomFor(bytes); mHeap += bytes; }
     String& buffer()                         { return mBuffer; }
     String& buffer(const String& s)          { mBuffer = s; return mBuffer; }
        void builtin(const String& x,
                     const Lambda& l,
                     int flags = 0)           { mDictionary[x] = new Builtin(l, flags); nameOf(mDictionary[x], x); }                         // NOLINT
+CompileCache* cache()                        { return mCache; }
+       void cache(CompileCache* c)           { mCache = c; }
       Code* code()                           { return mCode; }
+       bool columnar()                       { return mColumnar; }
       Code* code(Code* c)                    { mCode = c; return code(); }
        bool compiling()                      { return mCompiling; }
        bool compiling(bool c)                { mCompiling = c; return compiling(); }
      String debugging()                      { return nameOf(mDebug); }
+      Code* debugFrame()                     { return mDebug != nullptr && mActive.code == mDebug ? mDebug : nullptr; }
       auto& dictionary()                     { return mDictionary; }
+     String error()                          { return mError; }
        void dup()                            { mUser.dup(); }
+      Code* earlier(const String& s)         { auto at = mEarlier.find(s); return at != mEarlier.end() ? at->second : nullptr; }
+       void earlier(const String& s, Code* c) { if (c != nullptr) mEarlier[s] = c; else mEarlier.erase(s); }
        bool empty()                          { return mUser.empty(); }
-      auto& globals()                        { return mGlobals; }
+     Value* frame()                          { return mFrames.data() + mActive.base; }
+     Value* global(size_t n)                 { return mGlobalSlots.data() + mGlobals[n].offset; }
+     size_t globalOf(const String& name)     { auto at = mGlobalNames.find(name); return at != mGlobalNames.end() ? at->second : npos; }
+      auto& globals() const                  { return mGlobals; }
+     size_t heap()                           { return mHeap; }
        void install(External* x)             { x->install(this); }
+       bool inTask()                         { return mTask != nullptr; }
        bool isCompiling()                    { return compiling(); }
+      auto& limits()                         { return mLimits; }
+       void limits(const Limits& l)          { mLimits = l; }
        void move()                           { mUser.push(mSystem.pop()); }
      String nameOf(Code* c)                  { return mNameOf.contains(c) ? mNameOf[c] : L""; }
      String nameOf(Code* c, const String& s) { mNameOf[c] = s; return nameOf(c); }
-      Value nth(size_t n)                    { mUser.nth((Integer) n); return pop(); }
+       void need(size_t n)                   { mUser.need(n); }
+      Value nth(size_t n)                    { return mUser.at(n); }
        void over()                           { mUser.over(); }
       Value pop()                            { return mUser.pop(); }
+       void progress()                       { ++mProgress; }
        void push(const Value& v)             { mUser.push(v); }
-      auto& reverse()                        { return mReverse; }
+   uint64_t ran()                            { return mRan; }
+       void roomFor(size_t bytes)            { if (mLimits.heap != 0 && bytes > mLimits.heap - std::min(mHeap, mLimits.heap)) throw Error(Error::MEMORY_LIMIT, L"heap quota exceeded"); }
        void rot()                            { mUser.rot(); }
        void rrot()                           { mUser.rrot(); }
        bool skipping()                       { return mSkipping != 0; }
        bool skipping(bool s)                 { if (s) ++mSkipping; else --mSkipping; return skipping(); }
      size_t size()                           { return mUser.size(); }
        void swap()                           { mUser.swap(); }                                                                          // NOLINT
+       bool suspendable()                    { return mTask != nullptr && mFloor == 0; }
        void sysdup()                         { mSystem.push(mSystem.top()); }
+     Stack& systemStack()                    { return mSystem; }
        void sysmove()                        { mSystem.push(mUser.pop()); }
        void sysover()                        { mSystem.over(); }
       Value syspop()                         { return mSystem.pop(); }
        void syspush(const Value& v)          { mSystem.push(v); }
+     size_t syssize()                        { return mSystem.size(); }
+     size_t tasks()                          { return mTasks.size(); }
       Value systop()                         { return mSystem.top(); }
       Value top()                            { return mUser.top(); }
+     Stack& userStack()                      { return mUser; }
 
+    // Called by the interpreter at calls and backward jumps with the instructions run since the last call.
+    void tick(size_t n) {
+        mRan += n;
+        if (mLimits.instructions != 0 && mRan > mLimits.instructions) throw Error(Error::INSTRUCTION_LIMIT, L"instruction budget exhausted");
+        if (mLimits.time.count() != 0 && (++mChecks & 255) == 0 && std::chrono::steady_clock::now() > mDeadline) throw Error(Error::TIME_LIMIT, L"time slice exhausted");
+    }
+
+            const Activation& active() const   { return mActive; }
+                         void block();
                          void breakAt(int at);
               std::vector<At> breakPoints(Code* in);
+                    Compiled* cached(const String& name);
+                         void call(Compiled* code);
                          void clearStack();
+             std::set<String> copies(const String& name);
     std::vector<std::wstring> debug(const std::wstring& name);
+                       size_t declare(const String& name, size_t size = 1);
+                         void defined(const String& name, const String& source, Compiled* block);
+             std::set<String> dependents(const String& name);
+                         void depends(const String& name, const std::set<String>& uses, const std::set<String>& copies);
+                         void enter(Code* code);
                          bool execute(const std::wstring& s);
+                     uint64_t fingerprint(const String& name);
+                       String format(const Value& v);
     std::vector<std::wstring> getCompiled();
-    std::vector<std::wstring> globalVars();
-    std::vector<std::wstring> localVars();
+                const Global* globalAt(const Value* ptr) const;
+                         void join();
+                         void leave(const Activation& caller);
+                       String localName(const Value* ptr);
+                       size_t localSize(const Value* ptr);
+                        Code* operatorCode(int op) const   { return mOperators[op]; }
                        size_t pc();
         std::map<Value, int>& precedence() { return mPrecedence; };
+                    Compiled* redefining(const String& name);
+                         void recover(const Error& e);
+            std::set<String>& referred()       { return mReferred; }
+                         void resize(size_t n, size_t size);
+                         bool resume(Task& task);
+                        Round round();
+                         void sleep(std::chrono::milliseconds ms);
+                         void spawn(const String& word);
                          void run();
+                       size_t runBatch(Code* word, std::span<const Row> rows, const Sink& sink);
+                         bool runColumns(Code* word, std::span<TypedArray* const> columns, std::vector<Value>& out);
+                         bool running(Code* code);
+                         void start();
                          void stepInto();
                          void stepOver();
-    std::vector<std::wstring> user();
-    std::vector<std::wstring> system();
+                         void unwind(const Activation& to, size_t user, size_t system);
+                         void yield();
+      const std::set<String>& uses(const String& name) { return mUses[name]; }
          std::optional<Value> word(bool reload = false);
 
     std::wstring debugUserStack();
 
+private:
+                      size_t diverge(TypedArray* mask, size_t taken);
+                        void exchange(Task& task);
+                      size_t globalRoom(size_t size) const;
+    template<Step S> void interpret(size_t floor);
+                        void invoke(Compiled* code);
+  template<typename T> void operate(int op);
+                        void recompile(std::set<String> words);
+                        void remember(const String& name);
+                        void restore(const std::vector<Value>& user, const std::vector<Value>& system, const std::vector<Value>& frames);
+            std::set<String> stale(const String& name, bool moved);
+                        void step(Step how);
+                        void vacate(size_t from, size_t to);
 };
 
 }
@@ -1,8 +1,12 @@
 #include "MainWindow.h"
 #include "./ui_MainWindow.h"
+#include "Binding.h"
+#include "CompileCache.h"
+#include "Scheduler.h"
 #include "WordDialog.h"
 
 #include <QCloseEvent>
+#include <QHeaderView>
 #include <QMessageBox>
 
 #include <functional>
@@ -42,6 +46,17 @@ MainWindow::MainWindow(QWidget *parent)
     , ui(new Ui::MainWindow) {
     ui->setupUi(this);
 
+    mCodeModel = new CodeModel(this);                                             // NOLINT
+    mUserModel = new StackModel(&mVM, mVM.userStack(), this);                     // NOLINT
+    mSystemModel = new StackModel(&mVM, mVM.systemStack(), this);                 // NOLINT
+    mGlobalModel = new VarsModel(&mVM, VarsModel::GLOBALS, this);                 // NOLINT
+    mLocalModel = new VarsModel(&mVM, VarsModel::LOCALS, this);                   // NOLINT
+    setTable(ui->codeTable, mCodeModel);
+    setTable(ui->userTable, mUserModel);
+    setTable(ui->systemTable, mSystemModel);
+    setTable(ui->globalTable, mGlobalModel);
+    setTable(ui->localTable, mLocalModel);
+
     ui->actionRun->setDisabled(true);
     ui->actionSet_Breakpoint->setDisabled(true);
     ui->actionStep_Into->setDisabled(true);
@@ -80,6 +95,36 @@ void MainWindow::closeEvent(QCloseEvent* event) {
     } else event->accept();
 }
 
+// Host records for the binding tests.
+struct Order {
+    Fifth::Integer quantity;
+            double price;
+};
+
+template<> struct Fifth::Binding<Order> {
+    static constexpr const wchar_t* name = L"order";
+    static constexpr std::array members { Fifth::member<&Order::quantity>(L"quantity"), Fifth::member<&Order::price>(L"price") };
+};
+
+// Externals for the operator tests: one written against send() alone, one against operate().
+struct Tally: Fifth::External {
+    std::wstring seen;
+
+    void send(Fifth::VM*, const std::wstring& op, const Fifth::Value& right) override { seen += op + Fifth::asString(right); }
+};
+
+struct Counter: Fifth::External {
+    Fifth::Integer count = 0;
+              bool compared = false;
+
+    void operate(Fifth::VM*, Operator op, const Fifth::Value& right) override {
+        if (op == ADD) count += Fifth::asInteger(right);
+        compared |= op == LESS;
+    }
+    void send(Fifth::VM*, const std::wstring&, const Fifth::Value&) override { count = -1; }
+    std::wstring toString() override { return std::to_wstring(count); }
+};
+
 void MainWindow::runTests() {
     bool result = true;
     bool test = true;
@@ -165,16 +210,249 @@ void MainWindow::runTests() {
     result &= testExpression(RUN, "'this,is,a,test' ',' /", "this is a test 4");
     result &= testExpression(RUN, "'this' len", "4");
     result &= testExpression(RUN, "'this' explode", "t h i s 4");
+    result &= testExpression(RUN, "'the quick brown fox jumps over the lazy dog' 'lazy' find", "35");
+    result &= testExpression(RUN, "'the quick brown fox' 'cat' find", "-1");
+    result &= testExpression(RUN, "'the quick brown fox' 'brown' contains", "1");
+    result &= testExpression(RUN, "'the quick brown fox' 'the' starts-with", "1");
+    result &= testExpression(RUN, "'the quick brown fox' 'fox' ends-with", "1");
+    result &= testExpression(RUN, "'a;b;c;d;e;f;g;h;i;j;k;l;m;n;o;p;q' ';' ', ' replace", "'a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p, q'");
+    result &= testExpression(RUN, "'Hello, World! Mixed Case Text' upper", "'HELLO, WORLD! MIXED CASE TEXT'");
+    result &= testExpression(RUN, "'Hello, World! Mixed Case Text' lower", "'hello, world! mixed case text'");
+    result &= testExpression(RUN, "'apple' 'apricot' compare 'pear' 'pear' compare", "-1 0");
+    result &= testExpression(RUN, "10 int64[] 3 fill 2 * sum", "60");
+    result &= testExpression(RUN, "5 int64[] 0 5 put 1 -2 put 2 7 put 3 1 put 4 9 put dup min swap max", "-2 9");
+    result &= testExpression(RUN, "5 int64[] 0 5 put 1 -2 put 2 7 put 3 1 put 4 9 put 4 > sum", "3");
+    result &= testExpression(RUN, "6 int64[] 2 fill dup dot", "24");
+    result &= testExpression(RUN, "9 float64[] 0.5 fill 3 * sum", "13.500000");
+    result &= testExpression(RUN, "3 int64[] 1 4 put 1 [*]", "4");
+    result &= testExpression(RUN, "table dup 'k1' [] 10 <- dup 'k2' [] 20 <- dup 'k1' [*] swap dup 'missing' [*] swap len", "10 0 2");
+    result &= testExpression(RUN, "def table-fill"
+                                  " table"
+                                  " for i 1 1000 each"
+                                  "  dup i get [] i get <-"
+                                  " next "
+                                  "end");
+    result &= testExpression(RUN, "table-fill dup 500 [*] swap 250 - dup 250 [*] swap len", "500 0 999");
+    result &= testExpression(RUN, "table dup 1 [] 10 <- dup 2 [] 20 <- dup 3 [] 30 <- 1 - dup 4 [] 40 <- keys", "2 3 4 3");
+    result &= testExpression(RUN, "ordered dup 30 [] 3 <- dup 10 [] 1 <- dup 20 [] 2 <- keys", "10 20 30 3");
+    result &= testExpression(RUN, "table dup 1 [] 10 <- dup 2 [] 20 <- 1 - dup 3 [] 30 <- last", "3 30");
+    result &= testExpression(RUN, "ordered dup 5 [] 50 <- dup 1 [] 10 <- dup 9 [] 90 <- dup first rot last", "1 10 9 90");
+    result &= testExpression(RUN, "def series"
+                                  " ordered"
+                                  " for t 1000 1 by -1 each"
+                                  "  dup t get [] t get 10 * <-"
+                                  " next "
+                                  "end");
+    result &= testExpression(RUN, "series 200 300 range dup len swap dup first rot last", "101 200 2000 300 3000");
+    result &= testExpression(RUN, "vector 3 push 1 push 2 push sort dup 0 at swap 2 at", "1 3");
+    result &= testExpression(RUN, "vector 7 push 8 push pop-back swap len", "8 1");
+    result &= testExpression(RUN, "vector 1 push 2 push 3 push 4 push dup 1 3 slice dup 0 at rot rot concat len", "2 6");
+    result &= testExpression(RUN, "vector 5 push dup 0 [] 9 <- 0 [*]", "9");
+    result &= testExpression(RUN, "vector 5 push dup 0 [] swap 6 push 1000 reserve swap 9 <- 0 [*]", "9");
+    result &= testExpression(RUN, "def shrunk try vector 5 push dup 0 [] swap pop-back pop pop get catch swap pop endtry end shrunk", "-9");
+    result &= testExpression(RUN, "vector 'pear' push 'apple' push 'fig' push sort 0 at", "'apple'");
+    result &= testExpression(RUN, "def shuffled"
+                                  " vector 1000 reserve"
+                                  " for i 1 1000 each"
+                                  "  i get 37 * 1000 % 500 - push"
+                                  " next "
+                                  "end");
+    result &= testExpression(RUN, "shuffled sort dup 0 at swap dup 500 at swap len", "-500 0 1000");
+    result &= testExpression(RUN, "def fact"
+                                  " var n"
+                                  " n swap <-"
+                                  " if n get 1 <= then"
+                                  "  1"
+                                  " else"
+                                  "  n get 1 - fact n get *"
+                                  " endif "
+                                  "end");
+    result &= testExpression(RUN, "10 fact", "3628800");
+    result &= testExpression(RUN, "def fib"
+                                  " var n"
+                                  " n swap <-"
+                                  " if ( *n < 2 ) then"
+                                  "  n get"
+                                  " else"
+                                  "  n get 1 - fib n get 2 - fib +"
+                                  " endif "
+                                  "end");
+    result &= testExpression(RUN, "20 fib", "6765");
+    result &= testExpression(RUN, "def inc 1 + end def inc inc inc end 5 inc", "7");
+    result &= testExpression(RUN, "def bump 1 + 2 + 3 + 4 + 5 + end def bump bump bump end 0 bump", "30");
+    result &= testExpression(RUN, "def bump bump 1 + end 0 bump", "31");
+    result &= testExpression(RUN, "def max max end 3 4 max", "4");
+    result &= testExpression(RUN, "array g 3 var k");
+    result &= testExpression(RUN, "def g-sum g get g 2 + get + end");
+    result &= testExpression(RUN, "g 2 + 5 <- g 7 <- g-sum g size", "12 3");
+    result &= testExpression(RUN, "g 10 resize g size g-sum", "10 12");
+    result &= testExpression(RUN, "array ga 30000 array gb 30000 ga 1 resize array gc 29000 gc size", "29000");
+    result &= testExpression(RUN, "def grow try gb 40000 resize catch swap pop endtry end grow", "-8");
+    result &= testExpression(RUN, "ga 1 resize gb 1 resize gc 1 resize");
+    result &= testExpression(RUN, "5 6 7 rot", "6 7 5");
+    result &= testExpression(RUN, "5 6 7 rrot", "7 5 6");
+    result &= testExpression(RUN, "1 swap", "1");
+    result &= testExpression(RUN, "pop 2 3 +", "");
+    result &= testExpression(RUN, "def safe-div try / catch swap pop endtry end");
+    result &= testExpression(RUN, "10 2 safe-div 10 0 safe-div", "5 -10");
+    result &= testExpression(RUN, "4 int64[] 7 fill 0 safe-div", "-10");
+    result &= testExpression(RUN, "4 int64[] 3 fill 0.0 safe-div 4 int64[] 3 fill 4 float64[] 0.0 fill safe-div", "-10 -10");
+    result &= testExpression(RUN, "4 int64[] 3 fill 0.5 / sum 2 int64[] 3 fill 1.0 0.0 / * 1 [*]", "24 inf");
+    result &= testExpression(RUN, "def safe-mod try % catch swap pop endtry end");
+    result &= testExpression(RUN, "5 0.0 safe-div 5.0 0 safe-div 5 0.0 safe-mod 5 0.5 safe-mod 5.0 0 safe-mod", "-10 -10 -10 -10 -10");
+    result &= testExpression(RUN, "5 1.0 0.0 / * 7 1.0 0.0 / % 7 2.0 %", "inf 7.000000 1");
+    result &= testExpression(RUN, "3 int64[] 6 fill -1 / sum", "-18");
+    result &= testExpression(RUN, "2 int64[] -9223372036854775807 1 - fill -1 / 0 [*]", "-9223372036854775808");
+    result &= testExpression(RUN, "2 int64[] -9223372036854775807 1 - fill -1 % sum", "0");
+    Tally tally;
+    mVM.push(static_cast<Fifth::External*>(&tally));
+    result &= testExpression(RUN, "2 + 3 <", "External");
+    result &= tally.seen == L"+2<3";
+    Counter counter;
+    mVM.push(static_cast<Fifth::External*>(&counter));
+    result &= testExpression(RUN, "2 + 5 + 9 <", "7");
+    result &= counter.compared;
+    result &= testExpression(RUN, "def risky try 'boom' 42 throw 1 catch endtry end");
+    result &= testExpression(RUN, "risky", "'boom' 42");
+    result &= testExpression(RUN, "def inner var x x 5 <- 'five' int64[] end");
+    result &= testExpression(RUN, "def outer var y y 7 <- try inner catch swap pop endtry y get end");
+    result &= testExpression(RUN, "outer", "-24 7");
+    result &= testExpression(RUN, "1 0 / 2", "");
+    result &= testExpression(RUN, "-9223372036854775807 1 - -1 %", "0");
+    result &= testExpression(RUN, "-9223372036854775807 1 - -1.0 %", "0");
+    mVM.limits({ .instructions = 100000 });
+    result &= testExpression(RUN, "def spin while 1 do done end");
+    result &= testExpression(RUN, "spin 5", "");
+    result &= testExpression(RUN, "def spin-safe try spin catch endtry 5 end");
+    result &= testExpression(RUN, "spin-safe", "");
+    mVM.limits({ .depth = 50 });
+    result &= testExpression(RUN, "def deep deep 1 end");
+    result &= testExpression(RUN, "deep", "");
+    mVM.limits({ .heap = mVM.heap() + 1000 });
+    result &= testExpression(RUN, "'ab' 100000 *", "");
+    mVM.limits({});
+    result &= testExpression(RUN, "2 3 +", "5");
+    result &= testExpression(RUN, "var chan chan 2 channel <- var total");
+    result &= testExpression(RUN, "def producer for i 1 5 each chan get i get send pop next end");
+    result &= testExpression(RUN, "def consumer for j 1 5 each chan get recv swap pop total get + total swap <- next end");
+    result &= testExpression(RUN, "spawn consumer spawn producer join total get", "15");
+    result &= testExpression(RUN, "var turns turns vector <-");
+    result &= testExpression(RUN, "def ping for k 1 2 each turns get 'pi' push pop yield next end");
+    result &= testExpression(RUN, "def pong for k 1 2 each turns get 'po' push pop yield next end");
+    result &= testExpression(RUN, "spawn ping spawn pong join turns get", "['pi', 'po', 'pi', 'po']");
+    result &= testExpression(RUN, "def stuck chan get recv end");
+    result &= testExpression(RUN, "spawn stuck join 7", "");
+    // Two workers passing a value back and forth must never be taken for deadlocked while one is in flight.
+    Fifth::Scheduler rally(2);
+    rally.channel(L"serves", 1);
+    rally.channel(L"returns", 1);
+    for (int n = 0; n < 200 && result; ++n) {
+        rally.spawn(L"serve");
+        rally.spawn(L"volley");
+        result &= rally.run([](Fifth::VM& vm) {
+            vm.execute(L"def serve for i 1 200 each serves get i get send pop returns get recv pop pop next end");
+            vm.execute(L"def volley for i 1 200 each serves get recv swap pop returns get swap send pop next end");
+        });
+    }
+    result &= testExpression(RUN, "def countdown if dup 0 > then 1 - countdown endif end");
+    result &= testExpression(RUN, "100000 countdown", "0");
+    result &= testExpression(RUN, "def sq dup * end def quad sq sq end");
+    result &= testExpression(RUN, "3 quad", "81");
+    result &= testExpression(RUN, "def sq dup + end 3 quad", "12");
+    result &= testExpression(RUN, "def folded ( 10 - 2 * 3 ) end folded", "4");
+    result &= testExpression(RUN, "def squared var v v swap <- ( *v ^ 2 ) end 3 squared", "9.000000");
+    result &= testExpression(RUN, "def nine ( 3 ^ 2 ) end nine", "9.000000");
+    result &= testExpression(RUN, "( 3 ^ 2 )", "9.000000");
+    result &= testExpression(RUN, "( 2 - 3 - 4 )", "-5");
+    result &= testExpression(RUN, "def chain ( 2 - 3 - 4 ) ( 8 / 4 / 2 ) ( 2 ^ 3 ^ 2 ) end chain", "-5 1 512.000000");
+    result &= testExpression(RUN, "( 8 / 4 / 2 )", "1");
+    result &= testExpression(RUN, "def xor + end def mixed ( 6 xor 3 ) end mixed", "9");
+    result &= testExpression(RUN, "def xor * end mixed ( 6 xor 3 )", "18 18");
+    result &= testExpression(RUN, "def typed 2 3 + 4 * dup 20 = swap 1.5 2.5 < + end typed", "1 21");
+    result &= testExpression(RUN, "def plus + end 2 3 plus", "5");
+    result &= testExpression(RUN, "'ab' 'cd' plus", "'abcd'");
+    std::vector<Fifth::VM::Row> rows = { { 2, 3 }, { 4, 5 }, { 6 } };
+    Fifth::Integer sum = 0;
+    result &= mVM.runBatch(mVM.dictionary()[L"plus"], rows, [&sum](size_t, std::span<const Fifth::Value> stack, const Fifth::Error* error) {
+        if (error == nullptr) sum += std::get<Fifth::INTEGER>(stack.back());
+    }) == 2 && sum == 14;
+    result &= testExpression(RUN, "4 int64[] 3 fill 3 = sum", "4");
+    result &= testExpression(RUN, "10 4 int64[] 3 fill - sum", "28");
+    result &= testExpression(RUN, "def rule dup 8 > if then 2 * else 1 + endif end");
+    Fifth::TypedArray prices(Fifth::TypedArray::INT64, 4);
+    prices.put(1, 5);
+    prices.put(2, 10);
+    prices.put(3, 15);
+    Fifth::TypedArray* columns[] = { &prices };
+    std::vector<Fifth::Value> priced;
+    result &= mVM.runColumns(mVM.dictionary()[L"rule"], columns, priced) && Fifth::asString(priced.at(0)) == L"int64[1, 6, 20, 30]";
+    result &= testExpression(RUN, "def careful dup 8 > if then try 0 / catch swap pop endtry else 1 + endif end");
+    for (size_t n = 0; n <= Fifth::VM::DivergeLimit; ++n) {
+        result &= mVM.runColumns(mVM.dictionary()[L"careful"], columns, priced) && Fifth::asString(priced.at(0)) == L"int64[1, 6, -10, -10]";
+    }
+    result &= testExpression(RUN, "def inner dup 8 > if then 0 / else 1 + endif end def guarded try inner catch swap pop endtry end");
+    result &= !mVM.runColumns(mVM.dictionary()[L"guarded"], columns, priced) && mVM.error() == L"division by zero";
+    result &= testExpression(RUN, "def keeper var keep keep swap <- try keep get inner catch swap pop endtry keep get end");
+    result &= !mVM.runColumns(mVM.dictionary()[L"keeper"], columns, priced) && mVM.userStack().empty();
+    result &= mVM.runColumns(mVM.dictionary()[L"rule"], columns, priced) && Fifth::asString(priced.at(0)) == L"int64[1, 6, 20, 30]";
+    result &= testExpression(RUN, "def broken 1 2 3 0 / end");
+    result &= !mVM.runColumns(mVM.dictionary()[L"broken"], columns, priced) && mVM.userStack().empty();
+    static Order orders[] = { { 2, 1.5 }, { 3, 4.0 } };
+    static Fifth::Records<Order> book(orders);
+    mVM.install(&book);
+    Fifth::constant(mVM, L"book", &book);
+    Fifth::bind(mVM, L"hypot2", +[](double a, double b) { return a * a + b * b; });
+    Fifth::bind(mVM, L"greet", +[](const Fifth::String& who) { return L"hi " + who; });
+    Fifth::bind(mVM, L"letters", +[](Fifth::String s) { return s.size(); });
+    result &= testExpression(RUN, "book 1 order.quantity book 0 order.price", "3 1.500000");
+    result &= testExpression(RUN, "book 0 10 order.quantity! book 0 order.quantity 3 4 hypot2", "10 25.000000");
+    result &= orders[0].quantity == 10;
+    result &= testExpression(RUN, "'bob' greet 'hello' letters 42 letters", "'hi bob' 5 2");
+    result &= testExpression(RUN, "9223372036854775807 1 +", "9223372036854775808");
+    result &= testExpression(RUN, "9223372036854775807 1 + 1 -", "9223372036854775807");
+    result &= testExpression(RUN, "'99999999999999999999' bigint 2 *", "199999999999999999998");
+    result &= testExpression(RUN, "def big 9223372036854775807 2 * end big", "18446744073709551614");
+    result &= testExpression(RUN, "def past 9223372036854775807 1 + 1 + end past", "9223372036854775809");
+    result &= testExpression(RUN, "def square 9223372036854775807 dup * 2 * end square", "170141183460469231694793815568465002498");
+    result &= testExpression(RUN, "'0.10' 2 decimal '0.20' 2 decimal +", "0.30");
+    result &= testExpression(RUN, "'10' 2 decimal 3 /", "3.33");
+    result &= testExpression(RUN, "'1.25' 2 decimal 1 decimal 2.5 >", "0");
+    result &= testExpression(RUN, "def tidy 1 2 swap swap dup pop - 7 dup * 3 4 swap - end tidy", "-1 49 1");
+    result &= testExpression(RUN, "def looped var n n 3 <- while ( *n > 0 ) do n get dup pop 1 - n swap <- swap swap done n get end looped", "0");
+    result &= testExpression(RUN, "def settled 1 2 swap rot rrot swap dup pop 3 pop end settled", "1 2");
+    result &= static_cast<Fifth::Compiled*>(mVM.dictionary()[L"settled"])->size() == 3;
+    result &= testExpression(RUN, "def copies 5 dup 1 nth end copies", "5 5 5");
+    result &= static_cast<Fifth::Compiled*>(mVM.dictionary()[L"copies"])->size() == 4;
+    result &= testExpression(RUN, "def third swap pop swap pop end 1 2 3 third", "3");
+    result &= static_cast<Fifth::Compiled*>(mVM.dictionary()[L"third"])->size() == 4;
+    result &= testExpression(RUN, "def spread dup rot swap end 1 2 spread", "2 1 2");
+    result &= testExpression(RUN, "def answer var a a 40 <- a get 2 + end def asks answer end asks", "42");
+    result &= testExpression(RUN, "def answer var a a 1 <- a get end asks", "1");
+    result &= testExpression(RUN, "def early soon 1 + end def soon 5 end early", "6");
+    Fifth::CompileCache cache;
+    mVM.cache(&cache);
+    result &= testExpression(RUN, "def cached var c c 3 <- c get 1 2 + * end cached", "9");
+    result &= testExpression(RUN, "def cached var c c 3 <- c get 1 2 + * end cached", "9");
+    result &= cache.hits() == 1;
+    mVM.cache(nullptr);
     result &= testExpression(DUMP);
     cstd::out.putString("------\r\n");
     cstd::out.putString(QString("[%1] %2\r\n").arg(result ? "PASS" : "FAIL", result ? "All tests passed" : "Some tests failed").toStdWString());
     cstd::out.flush();
 }
 
-void MainWindow::setCell(QTableWidget* tbl, int row, int col, QString val) {
-    QLabel* cell = new QLabel(val); // NOLINT
-    cell->setFont(tbl->font());
-    tbl->setCellWidget(row, col, cell);
+static constexpr int RowPadding = 4;
+
+// Rows are one line of the table's font high rather than measured, so a step never has to lay out every row.
+void MainWindow::setTable(QTableView* table, QAbstractTableModel* model) {
+    table->setModel(model);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    table->verticalHeader()->setDefaultSectionSize(table->fontMetrics().height() + RowPadding);
+    auto horizontalHeader = table->horizontalHeader();
+    horizontalHeader->setStretchLastSection(true);
+    horizontalHeader->setDefaultAlignment(Qt::AlignLeft);
+    if (model->columnCount() > 1) horizontalHeader->setSectionResizeMode(0, QHeaderView::ResizeToContents);
 }
 
 bool MainWindow::testExpression(testType type, const QString& in, const QString& out) {
@@ -214,76 +492,19 @@ void MainWindow::update() {
         ui->actionSet_Breakpoint->setDisabled(true);
         ui->actionStep_Into->setDisabled(true);
         ui->actionStep_Over->setDisabled(true);
-        ui->codeTable->setRowCount(0);
+        mCodeModel->clear();
     }
 
     updateCode(code);
-    updateStack(ui->userTable, toStringList(mVM.user()));
-    updateStack(ui->systemTable, toStringList(mVM.system()));
-    updateVars(ui->globalTable, mWord.isEmpty() ? QStringList() : toStringList(mVM.globalVars()));
-    updateVars(ui->localTable, mWord.isEmpty() ? QStringList() : toStringList(mVM.localVars()));
+    mUserModel->refresh();
+    mSystemModel->refresh();
+    mGlobalModel->refresh(!mWord.isEmpty());
+    mLocalModel->refresh(!mWord.isEmpty());
 }
 
 void MainWindow::updateCode(const QStringList& code) {
-    auto horizontalHeader = ui->codeTable->horizontalHeader();
-    horizontalHeader->setStretchLastSection(true);
-    horizontalHeader->setDefaultSectionSize(10); // NOLINT
-    horizontalHeader->setDefaultAlignment(Qt::AlignLeft);
-    ui->codeTable->setHorizontalHeaderLabels({ "OpCode", "Argmuents" });
-    if (!code.isEmpty()) {
-        ui->codeTable->clear();
-        ui->codeTable->setRowCount(code.size());  // NOLINT
-        int row = 0;
-        for (const auto& line: code) {
-            auto parts = line.split(",");
-            setCell(ui->codeTable, row, 0, parts[1]);
-            if (parts.size() > 2) {
-                QString content;
-                for (int i = 2; i < parts.size(); ++i) content += ((i == 2) ? "" : ",") + parts[i];
-                setCell(ui->codeTable, row, 1, content);
-            }
-            ++row;
-        }
-    }
-    for (int i = 0; i < ui->codeTable->rowCount(); ++i) ui->codeTable->resizeRowToContents(i);
-    for (int i = 0; i < ui->codeTable->columnCount(); ++i) ui->codeTable->resizeColumnToContents(i);
-
-    if (ui->codeTable->rowCount() != 0) ui->codeTable->selectRow(int(mVM.pc()));
-}
-
-void MainWindow::updateStack(QTableWidget* table, const QStringList& contents)
-{
-    table->clear();
-    table->setRowCount(contents.size());  // NOLINT
-    int row = 0;
-    for (const auto& line: contents) {
-        setCell(table, row, 0, line);
-        ++row;
-    }
-    for (int i = 0; i < table->rowCount(); ++i) table->resizeRowToContents(i);
-    for (int i = 0; i < table->columnCount(); ++i) table->resizeColumnToContents(i);
-}
-
-void MainWindow::updateVars(QTableWidget* table, const QStringList& vars)
-{
-    table->clear();
-    auto horizontalHeader = table->horizontalHeader();
-    horizontalHeader->setStretchLastSection(true);
-    horizontalHeader->setDefaultSectionSize(10); // NOLINT
-    horizontalHeader->setDefaultAlignment(Qt::AlignLeft);
-    table->setHorizontalHeaderLabels({ "Name", "Value" });
-    table->setRowCount(vars.size());  // NOLINT
-    int row = 0;
-    for (const auto& line: vars) {
-        auto parts = line.split(",");
-        setCell(table, row, 0, parts[0]);
-        QString content;
-        for (int i = 1; i < parts.size(); ++i) content += ((i == 1) ? "" : ",") + parts[i];
-        setCell(table, row, 1, content);
-        ++row;
-    }
-    for (int i = 0; i < table->rowCount(); ++i) table->resizeRowToContents(i);
-    for (int i = 0; i < table->columnCount(); ++i) table->resizeColumnToContents(i);
+    if (!code.isEmpty()) mCodeModel->setCode(code);
+    if (mCodeModel->rowCount() != 0) ui->codeTable->selectRow(int(mVM.pc()));
 }
 
 void MainWindow::exitTrigger() {
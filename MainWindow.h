@@ -2,8 +2,9 @@
 
 #include <QAbstractButton>
 #include <QMainWindow>
-#include <QTableWidget>
+#include <QTableView>
 
+#include "DebugModel.h"
 #include "Fifth.h"
 
 QT_BEGIN_NAMESPACE
@@ -29,6 +30,11 @@ private:
          Fifth::VM mVM;
               bool mRunning = true;
            QString mWord;
+        CodeModel* mCodeModel;
+       StackModel* mUserModel;
+       StackModel* mSystemModel;
+        VarsModel* mGlobalModel;
+        VarsModel* mLocalModel;
 
     enum testType { RUN, STACK, DUMP, OUT };
 
@@ -36,13 +42,11 @@ private:
 
            void justClose();
            void runTests();
-           void setCell(QTableWidget* tbl, int row, int col, QString val);
+           void setTable(QTableView* table, QAbstractTableModel* model);
            bool testExpression(testType, const QString& in = "", const QString& out = "");
     QStringList toStringList(const std::vector<std::wstring>& inputList);
            void update();
            void updateCode(const QStringList& code);
-           void updateStack(QTableWidget* table, const QStringList& contents);
-           void updateVars(QTableWidget* table, const QStringList& vars);
 
 public slots:
     void exitTrigger();
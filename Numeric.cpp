@@ -0,0 +1,296 @@
+#include "Numeric.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cwctype>
+
+namespace Fifth {
+
+using Limbs = std::vector<uint32_t>;
+
+static constexpr uint64_t Radix = uint64_t(1) << 32;
+static constexpr uint32_t Chunk = 1000000000;   // decimal digits are converted nine at a time
+
+static void trim(Limbs& a) {
+    while (!a.empty() && a.back() == 0) a.pop_back();
+}
+
+static int compareMagnitude(const Limbs& a, const Limbs& b) {
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    for (size_t i = a.size(); i > 0; --i) {
+        if (a[i - 1] != b[i - 1]) return a[i - 1] < b[i - 1] ? -1 : 1;
+    }
+    return 0;
+}
+
+static Limbs addMagnitude(const Limbs& a, const Limbs& b) {
+    const Limbs& longer = a.size() >= b.size() ? a : b;
+    const Limbs& shorter = a.size() >= b.size() ? b : a;
+    Limbs sum(longer.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); ++i) {
+        carry += uint64_t(longer[i]) + (i < shorter.size() ? shorter[i] : 0);
+        sum[i] = uint32_t(carry);
+        carry >>= 32;
+    }
+    sum.back() = uint32_t(carry);
+    trim(sum);
+    return sum;
+}
+
+// a - b, for a no smaller than b.
+static Limbs subtractMagnitude(const Limbs& a, const Limbs& b) {
+    Limbs difference(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        int64_t x = int64_t(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = x < 0 ? 1 : 0;
+        difference[i] = uint32_t(x + (borrow != 0 ? int64_t(Radix) : 0));
+    }
+    trim(difference);
+    return difference;
+}
+
+static Limbs multiplyMagnitude(const Limbs& a, const Limbs& b) {
+    if (a.empty() || b.empty()) return {};
+    Limbs product(a.size() + b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.size(); ++j) {
+            carry += uint64_t(a[i]) * b[j] + product[i + j];
+            product[i + j] = uint32_t(carry);
+            carry >>= 32;
+        }
+        product[i + b.size()] = uint32_t(carry);
+    }
+    trim(product);
+    return product;
+}
+
+// Divides a in place by a single limb and returns the remainder.
+static uint32_t divideSmall(Limbs& a, uint32_t d) {
+    uint64_t rest = 0;
+    for (size_t i = a.size(); i > 0; --i) {
+        uint64_t x = (rest << 32) | a[i - 1];
+        a[i - 1] = uint32_t(x / d);
+        rest = x % d;
+    }
+    trim(a);
+    return uint32_t(rest);
+}
+
+// Schoolbook division a bit at a time; the numbers scripts meet are a few limbs long.
+static Limbs divideMagnitude(const Limbs& a, const Limbs& b, Limbs& rest) {
+    rest.clear();
+    if (compareMagnitude(a, b) < 0) {
+        rest = a;
+        return {};
+    }
+    if (b.size() == 1) {
+        Limbs quotient = a;
+        uint32_t r = divideSmall(quotient, b[0]);
+        if (r != 0) rest.push_back(r);
+        return quotient;
+    }
+    Limbs quotient(a.size());
+    for (size_t bit = a.size() * 32; bit > 0; --bit) {
+        size_t at = bit - 1;
+        uint32_t carry = (a[at / 32] >> (at % 32)) & 1;
+        for (auto& limb: rest) {
+            uint32_t top = limb >> 31;
+            limb = (limb << 1) | carry;
+            carry = top;
+        }
+        if (carry != 0) rest.push_back(carry);
+        if (compareMagnitude(rest, b) >= 0) {
+            rest = subtractMagnitude(rest, b);
+            quotient[at / 32] |= uint32_t(1) << (at % 32);
+        }
+    }
+    trim(quotient);
+    return quotient;
+}
+
+Big Big::from(bool negative, Limbs limbs) {
+    trim(limbs);
+    if (limbs.size() <= 2) {
+        uint64_t u = limbs.empty() ? 0 : limbs[0];
+        if (limbs.size() == 2) u |= uint64_t(limbs[1]) << 32;
+        if (!negative && u <= uint64_t(std::numeric_limits<Integer>::max())) return Big(Integer(u));
+        if (negative && u <= uint64_t(std::numeric_limits<Integer>::max()) + 1) return Big(Integer(0 - u));
+    }
+    Big big;
+    big.mLarge = true;
+    big.mNegative = negative;
+    big.mLimbs = std::move(limbs);
+    return big;
+}
+
+Limbs Big::magnitude() const {
+    if (mLarge) return mLimbs;
+    uint64_t u = mSmall < 0 ? 0 - uint64_t(mSmall) : uint64_t(mSmall);
+    Limbs limbs { uint32_t(u), uint32_t(u >> 32) };
+    trim(limbs);
+    return limbs;
+}
+
+Big Big::fromReal(Real x) {
+    bool negative = x < 0;
+    Real rest = std::floor(std::fabs(x));
+    Limbs limbs;
+    while (rest >= 1) {
+        limbs.push_back(uint32_t(std::fmod(rest, Real(Radix))));
+        rest = std::floor(rest / Real(Radix));
+    }
+    return from(negative, limbs);
+}
+
+std::optional<Big> Big::parse(const String& s) {
+    size_t at = 0;
+    bool negative = false;
+    if (at < s.size() && (s[at] == L'-' || s[at] == L'+')) negative = s[at++] == L'-';
+    if (at == s.size()) return std::nullopt;
+    Limbs limbs;
+    while (at < s.size()) {
+        size_t digits = std::min<size_t>(9, s.size() - at);
+        uint32_t chunk = 0, scale = 1;
+        for (size_t i = 0; i < digits; ++i, ++at) {
+            if (!std::iswdigit(s[at])) return std::nullopt;
+            chunk = chunk * 10 + uint32_t(s[at] - L'0');
+            scale *= 10;
+        }
+        uint64_t carry = chunk;
+        for (auto& limb: limbs) {
+            carry += uint64_t(limb) * scale;
+            limb = uint32_t(carry);
+            carry >>= 32;
+        }
+        if (carry != 0) limbs.push_back(uint32_t(carry));
+    }
+    return from(negative, limbs);
+}
+
+Big Big::pow10(unsigned n) {
+    Big p(1);
+    for (; n >= 18; n -= 18) p = p * Big(1000000000000000000LL);
+    Integer rest = 1;
+    for (; n > 0; --n) rest *= 10;
+    return p * Big(rest);
+}
+
+Big Big::divide(const Big& n, const Big& d, Big* remainder) {
+    if (!n.mLarge && !d.mLarge && !(n.mSmall == std::numeric_limits<Integer>::min() && d.mSmall == -1)) {
+        if (remainder != nullptr) *remainder = Big(n.mSmall % d.mSmall);
+        return Big(n.mSmall / d.mSmall);
+    }
+    Limbs rest;
+    Limbs quotient = divideMagnitude(n.magnitude(), d.magnitude(), rest);
+    if (remainder != nullptr) *remainder = from(n.negative(), rest);
+    return from(n.negative() != d.negative(), quotient);
+}
+
+int Big::compare(const Big& other) const {
+    if (!mLarge && !other.mLarge) return mSmall < other.mSmall ? -1 : mSmall > other.mSmall ? 1 : 0;
+    if (negative() != other.negative()) return negative() ? -1 : 1;
+    int c = compareMagnitude(magnitude(), other.magnitude());
+    return negative() ? -c : c;
+}
+
+Big Big::operator-() const {
+    if (!mLarge && mSmall != std::numeric_limits<Integer>::min()) return Big(-mSmall);
+    return from(!negative(), magnitude());
+}
+
+Real Big::toReal() const {
+    if (!mLarge) return Real(mSmall);
+    Real x = 0;
+    for (size_t i = mLimbs.size(); i > 0; --i) x = x * Real(Radix) + mLimbs[i - 1];
+    return mNegative ? -x : x;
+}
+
+String Big::toString() const {
+    if (!mLarge) return std::to_wstring(mSmall);
+    Limbs rest = mLimbs;
+    std::vector<uint32_t> chunks;
+    while (!rest.empty()) chunks.push_back(divideSmall(rest, Chunk));
+    String s = mNegative ? L"-" : L"";
+    s += std::to_wstring(chunks.back());
+    for (size_t i = chunks.size() - 1; i > 0; --i) {
+        String part = std::to_wstring(chunks[i - 1]);
+        s += String(9 - part.size(), L'0') + part;
+    }
+    return s;
+}
+
+Big operator+(const Big& a, const Big& b) {
+    if (Integer r = 0; !a.mLarge && !b.mLarge && !addOverflows(a.mSmall, b.mSmall, r)) return Big(r);
+    Limbs x = a.magnitude(), y = b.magnitude();
+    if (a.negative() == b.negative()) return Big::from(a.negative(), addMagnitude(x, y));
+    if (compareMagnitude(x, y) >= 0) return Big::from(a.negative(), subtractMagnitude(x, y));
+    return Big::from(b.negative(), subtractMagnitude(y, x));
+}
+
+Big operator-(const Big& a, const Big& b) {
+    if (Integer r = 0; !a.mLarge && !b.mLarge && !subtractOverflows(a.mSmall, b.mSmall, r)) return Big(r);
+    return a + -b;
+}
+
+Big operator*(const Big& a, const Big& b) {
+    if (Integer r = 0; !a.mLarge && !b.mLarge && !multiplyOverflows(a.mSmall, b.mSmall, r)) return Big(r);
+    return Big::from(a.negative() != b.negative(), multiplyMagnitude(a.magnitude(), b.magnitude()));
+}
+
+// Saturates at the ends of Integer's range.
+Integer BigInt::toInteger() {
+    if (mValue.fits()) return mValue.small();
+    return mValue.negative() ? std::numeric_limits<Integer>::min() : std::numeric_limits<Integer>::max();
+}
+
+// Accepts an optional sign, digits and an optional point followed by more digits.
+bool Decimal::parse(const String& s, Big& units, unsigned& scale) {
+    size_t point = s.find(L'.');
+    String digits = point == String::npos ? s : s.substr(0, point) + s.substr(point + 1);
+    scale = point == String::npos ? 0 : unsigned(s.size() - point - 1);
+    if (scale > MaxScale || (point != String::npos && s.find(L'.', point + 1) != String::npos)) return false;
+    auto parsed = Big::parse(digits);
+    if (!parsed.has_value()) return false;
+    units = *parsed;
+    return true;
+}
+
+// Units of 10^-from as units of 10^-to, rounding half away from zero when digits are dropped.
+Big Decimal::rescale(const Big& units, unsigned from, unsigned to) {
+    if (to >= from) return to == from ? units : units * Big::pow10(to - from);
+    return round(units, Big::pow10(from - to));
+}
+
+// n / d rounded half away from zero. d must not be zero.
+Big Decimal::round(const Big& n, const Big& d) {
+    Big rest;
+    Big quotient = Big::divide(n, d, &rest);
+    Big twice = rest * Big(2);
+    if ((twice.negative() ? -twice : twice).compare(d.negative() ? -d : d) >= 0) quotient = quotient + Big(n.negative() != d.negative() ? -1 : 1);
+    return quotient;
+}
+
+Real Decimal::toReal() {
+    return mUnits.toReal() / Big::pow10(mScale).toReal();
+}
+
+String Decimal::toString() {
+    String digits = (mUnits.negative() ? -mUnits : mUnits).toString();
+    if (mScale > 0) {
+        if (digits.size() <= mScale) digits = String(mScale + 1 - digits.size(), L'0') + digits;
+        digits.insert(digits.size() - mScale, L".");
+    }
+    return (mUnits.negative() ? L"-" : L"") + digits;
+}
+
+// Truncates towards zero and saturates at the ends of Integer's range.
+Integer Decimal::toInteger() {
+    Big whole = Big::divide(mUnits, Big::pow10(mScale));
+    if (whole.fits()) return whole.small();
+    return whole.negative() ? std::numeric_limits<Integer>::min() : std::numeric_limits<Integer>::max();
+}
+
+}
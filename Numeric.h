@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Fifth.h"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace Fifth {
+
+// Integer arithmetic that says when it overflows instead of wrapping; r is only meaningful when it did not.
+inline bool addOverflows(Integer a, Integer b, Integer& r) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_add_overflow(a, b, &r);
+#else
+    if ((b > 0 && a > std::numeric_limits<Integer>::max() - b) || (b < 0 && a < std::numeric_limits<Integer>::min() - b)) return true;
+    r = a + b;
+    return false;
+#endif
+}
+
+inline bool subtractOverflows(Integer a, Integer b, Integer& r) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_sub_overflow(a, b, &r);
+#else
+    if ((b < 0 && a > std::numeric_limits<Integer>::max() + b) || (b > 0 && a < std::numeric_limits<Integer>::min() + b)) return true;
+    r = a - b;
+    return false;
+#endif
+}
+
+inline bool multiplyOverflows(Integer a, Integer b, Integer& r) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_mul_overflow(a, b, &r);
+#else
+    if (a == 0 || b == 0) {
+        r = 0;
+        return false;
+    }
+    if ((a == -1 && b == std::numeric_limits<Integer>::min()) || (b == -1 && a == std::numeric_limits<Integer>::min())) return true;
+    r = Integer(static_cast<unsigned long long>(a) * static_cast<unsigned long long>(b));
+    return r / b != a;
+#endif
+}
+
+// An integer of any size. One that fits an Integer is kept as one, so arithmetic on it costs a checked Integer
+// operation; past that it is a sign and a magnitude in 32 bit limbs, least significant first.
+class Big {
+private:
+                  Integer mSmall = 0;
+                     bool mLarge = false;
+                     bool mNegative = false;
+    std::vector<uint32_t> mLimbs;
+
+    static Big from(bool negative, std::vector<uint32_t> limbs);
+    std::vector<uint32_t> magnitude() const;
+
+public:
+    Big(Integer v = 0)
+        : mSmall(v)
+    { }
+
+    static Big fromReal(Real x);                   // truncated
+    static std::optional<Big> parse(const String& s);
+    static Big pow10(unsigned n);
+
+    // Truncating division, as Integer's is; the remainder takes the sign of n. d must not be zero.
+    static Big divide(const Big& n, const Big& d, Big* remainder = nullptr);
+
+        bool fits() const        { return !mLarge; }
+        bool negative() const    { return mLarge ? mNegative : mSmall < 0; }
+     Integer small() const       { return mSmall; }
+        bool zero() const        { return !mLarge && mSmall == 0; }
+      size_t bytes() const       { return mLimbs.size() * sizeof(uint32_t); }
+
+         int compare(const Big& other) const;
+         Big operator-() const;
+        Real toReal() const;
+      String toString() const;
+
+    friend Big operator+(const Big& a, const Big& b);
+    friend Big operator-(const Big& a, const Big& b);
+    friend Big operator*(const Big& a, const Big& b);
+};
+
+// An integer past the range of Integer. Smaller results of arithmetic on one become plain Integers again.
+class BigInt: public External {
+private:
+    Big mValue;
+
+public:
+    BigInt(const Big& v)
+        : mValue(v)
+    { }
+
+    const Big& value() const      { return mValue; }
+
+         bool empty() override     { return mValue.zero(); }
+         Real toReal() override    { return mValue.toReal(); }
+       String toString() override  { return mValue.toString(); }
+      Integer toInteger() override;
+};
+
+// A fixed point number: a count of units of 10^-scale. Adding, subtracting and comparing are exact; multiplying and
+// dividing round half away from zero to the larger scale of the two operands.
+class Decimal: public External {
+private:
+         Big mUnits;
+    unsigned mScale;
+
+public:
+    static constexpr unsigned MaxScale = 38;
+
+    Decimal(const Big& units, unsigned scale)
+        : mUnits(units)
+        , mScale(scale)
+    { }
+
+    static bool parse(const String& s, Big& units, unsigned& scale);
+    static Big rescale(const Big& units, unsigned from, unsigned to);
+    static Big round(const Big& n, const Big& d);
+
+    unsigned scale() const        { return mScale; }
+  const Big& units() const        { return mUnits; }
+
+         bool empty() override     { return mUnits.zero(); }
+         Real toReal() override;
+       String toString() override;
+      Integer toInteger() override;
+};
+
+}
@@ -0,0 +1,283 @@
+#include "Registers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+namespace Fifth {
+
+using Instruction = Compiled::Instruction;
+
+// Deepest value a run follows nth down to; a deeper one ends the run instead.
+static constexpr Integer NthLimit = 8;
+// Most values a run may take, and then leave, for the shortest code that does the same to be searched for, and the
+// most stacks the search may look at before it settles for the code the run came from.
+static constexpr size_t SearchLimit = 4;
+static constexpr size_t StateLimit  = 2000;
+
+static bool pushes(const Instruction& in) {
+    return in.op() == Compiled::PUSH || in.op() == Compiled::LOCAL || in.op() == Compiled::GLOBAL;
+}
+
+static bool jumps(const Instruction& in) {
+    Compiled::opCode op = in.op();
+    return op == Compiled::JUMP || op == Compiled::BRANCH || op == Compiled::TRY || op == Compiled::ENDTRY;
+}
+
+static bool calls(const Instruction& in, Code* code) {
+    return code != nullptr && in.op() == Compiled::CALL && in.code() == code;
+}
+
+// Splits block into runs at every instruction that is not a push or a shuffle and every instruction a jump lands on,
+// following each run's stack as registers.
+RegisterForm::RegisterForm(VM* vm, const std::vector<Instruction>& block)
+    : mBlock(block)
+{
+    auto builtin = [vm](const wchar_t* name) -> Code* {
+        auto at = vm->dictionary().find(name);
+        return at == vm->dictionary().end() || at->second->compiled() ? nullptr : at->second;
+    };
+    mShuffles = { builtin(L"dup"), builtin(L"nth"), builtin(L"pop"), builtin(L"rot"), builtin(L"rrot"), builtin(L"swap") };
+
+    std::vector<bool> target(mBlock.size() + 1, false);
+    for (size_t pc = 0; pc < mBlock.size(); ++pc) {
+        if (!jumps(mBlock[pc])) continue;
+        if (ptrdiff_t to = ptrdiff_t(pc) + 1 + mBlock[pc].by(); to >= 0 && size_t(to) <= mBlock.size()) target[size_t(to)] = true;
+    }
+
+    for (size_t pc = 0; pc < mBlock.size(); ) {
+        Run run;
+        run.from = pc;
+        std::vector<Reg> stack;
+        auto need = [&](size_t n) { while (stack.size() < n) stack.insert(stack.begin(), Reg{ true, run.found++ }); };
+        auto copy = [&](Reg r) {
+            run.nodes.push_back({ Instruction(Compiled::NOP), r });
+            stack.push_back({ false, run.nodes.size() - 1 });
+        };
+        // The index nth is given, if the run pushed it as a literal.
+        auto index = [&]() -> std::optional<Integer> {
+            if (stack.empty()) return std::nullopt;
+            Reg r = stack.back();
+            while (!r.found && run.nodes[r.n].push.op() == Compiled::NOP) r = run.nodes[r.n].from;
+            if (r.found || run.nodes[r.n].push.op() != Compiled::PUSH) return std::nullopt;
+            Value v = run.nodes[r.n].push.value();
+            if (v.index() != INTEGER || std::get<INTEGER>(v) < 0 || std::get<INTEGER>(v) > NthLimit) return std::nullopt;
+            return std::get<INTEGER>(v);
+        };
+
+        for (; pc < mBlock.size() && (pc == run.from || !target[pc]); ++pc) {
+            const Instruction& in = mBlock[pc];
+            if (pushes(in)) {
+                run.nodes.push_back({ in, {} });
+                stack.push_back({ false, run.nodes.size() - 1 });
+                continue;
+            }
+            if (in.op() == Compiled::POP || calls(in, mShuffles.pop)) {
+                need(1);
+                stack.pop_back();
+            } else if (calls(in, mShuffles.dup)) {
+                need(1);
+                copy(stack.back());
+            } else if (calls(in, mShuffles.swap)) {
+                need(2);
+                std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
+            } else if (calls(in, mShuffles.rot)) {
+                need(3);
+                std::rotate(stack.end() - 3, stack.end() - 2, stack.end());
+            } else if (calls(in, mShuffles.rrot)) {
+                need(3);
+                std::rotate(stack.end() - 3, stack.end() - 1, stack.end());
+            } else if (auto n = index(); calls(in, mShuffles.nth) && n.has_value()) {
+                stack.pop_back();
+                need(size_t(*n) + 1);
+                copy(stack[stack.size() - 1 - size_t(*n)]);
+            } else break;
+            run.shuffles = true;
+        }
+        if (pc == run.from) {
+            ++pc;
+            continue;
+        }
+        run.to = pc;
+        run.leaves = std::move(stack);
+        mRuns.push_back(std::move(run));
+    }
+}
+
+void RegisterForm::propagate() {
+    for (auto& run: mRuns) {
+        for (auto& leaf: run.leaves) {
+            while (!leaf.found && run.nodes[leaf.n].push.op() == Compiled::NOP) leaf = run.nodes[leaf.n].from;
+        }
+    }
+}
+
+void RegisterForm::prune() {
+    for (auto& run: mRuns) {
+        for (auto& node: run.nodes) node.live = false;
+        for (const auto& leaf: run.leaves) if (!leaf.found) run.nodes[leaf.n].live = true;
+    }
+}
+
+// Stack code shorter than limit instructions that leaves what run does, if one is found. The values at the bottom
+// that the run leaves where they were need no code. Where it took no others, what it leaves on top of them is pushed
+// or copied in turn; otherwise stacks are searched, cheapest first, for one that can be shuffled into what it leaves.
+std::optional<std::vector<Instruction>> RegisterForm::schedule(const Run& run, size_t limit) const {
+    std::vector<Reg> start;
+    for (size_t n = run.found; n-- > 0; ) start.push_back({ true, n });
+    size_t kept = 0;
+    while (kept < start.size() && kept < run.leaves.size() && start[kept] == run.leaves[kept]) ++kept;
+    std::vector<Reg> from(start.begin() + ptrdiff_t(kept), start.end());
+    std::vector<Reg> goal(run.leaves.begin() + ptrdiff_t(kept), run.leaves.end());
+    auto nth = [this](size_t depth) {
+        return std::vector<Instruction>{ Instruction(Compiled::PUSH, Value(Integer(depth))), Instruction(Compiled::CALL, mShuffles.nth) };
+    };
+
+    if (from.empty()) {
+        std::vector<Instruction> code;
+        std::vector<Reg> stack(run.leaves.begin(), run.leaves.begin() + ptrdiff_t(kept));
+        for (const auto& reg: goal) {
+            auto at = std::find(stack.rbegin(), stack.rend(), reg);
+            if (!reg.found) code.push_back(run.nodes[reg.n].push);
+            else if (at == stack.rbegin() && mShuffles.dup != nullptr) code.emplace_back(Compiled::CALL, mShuffles.dup);
+            else if (at != stack.rend() && mShuffles.nth != nullptr) for (const auto& in: nth(size_t(at - stack.rbegin()))) code.push_back(in);
+            else return std::nullopt;
+            stack.push_back(reg);
+        }
+        if (code.size() >= limit) return std::nullopt;
+        return code;
+    }
+    if (from.size() > SearchLimit || goal.size() > SearchLimit + 2) return std::nullopt;
+
+    // The search numbers the few registers it sees and packs a stack of them into one word, a nibble each above its
+    // height, so that looking a stack up costs no more than hashing an integer.
+    std::vector<Reg> regs;
+    auto id = [&regs](Reg reg) {
+        auto at = std::find(regs.begin(), regs.end(), reg);
+        if (at != regs.end()) return uint64_t(at - regs.begin());
+        regs.push_back(reg);
+        return uint64_t(regs.size() - 1);
+    };
+    auto pack = [&id](const std::vector<Reg>& stack) {
+        uint64_t key = stack.size();
+        for (size_t i = 0; i < stack.size(); ++i) key |= id(stack[i]) << (4 * i + 4);
+        return key;
+    };
+    auto height = [](uint64_t key) { return size_t(key & 0xf); };
+    auto at = [](uint64_t key, size_t i) { return (key >> (4 * i + 4)) & 0xf; };
+    auto put = [](uint64_t key, size_t i, uint64_t reg) { return (key & ~(uint64_t(0xf) << (4 * i + 4))) | reg << (4 * i + 4); };
+    auto push = [&](uint64_t key, uint64_t reg) { return put(key + 1, height(key), reg); };
+
+    const uint64_t begin = pack(from);
+    const uint64_t end = pack(goal);
+    std::vector<uint64_t> needed;             // found registers the goal holds, which nothing can make again
+    for (const auto& reg: goal) if (reg.found) needed.push_back(id(reg));
+    std::vector<uint64_t> pushed;
+    for (const auto& reg: goal) if (!reg.found) pushed.push_back(id(reg));
+    std::sort(pushed.begin(), pushed.end());
+    pushed.erase(std::unique(pushed.begin(), pushed.end()), pushed.end());
+    const size_t tallest = std::max(from.size(), goal.size()) + 1;
+
+    // Each move the search may make, as the code for it; a push of the i-th pushed register comes first.
+    std::vector<std::vector<Instruction>> moves;
+    for (uint64_t reg: pushed) moves.push_back({ run.nodes[regs[reg].n].push });
+    const size_t pop = moves.size();
+    moves.push_back({ Instruction(Compiled::POP) });
+    const size_t copy = moves.size();
+    moves.push_back({ Instruction(Compiled::CALL, mShuffles.dup) });
+    for (size_t depth = 1; depth < tallest; ++depth) moves.push_back(nth(depth));
+    const size_t swap = moves.size();
+    moves.push_back({ Instruction(Compiled::CALL, mShuffles.swap) });
+    moves.push_back({ Instruction(Compiled::CALL, mShuffles.rot) });
+    moves.push_back({ Instruction(Compiled::CALL, mShuffles.rrot) });
+
+    struct Step {
+        uint64_t stack;
+          size_t parent;
+          size_t move;    // what took the parent's stack to this one
+    };
+    std::vector<Step> steps { { begin, 0, 0 } };
+    std::unordered_map<uint64_t, size_t> cheapest { { begin, 0 } };
+    std::vector<std::vector<size_t>> queue(limit);
+    queue[0].push_back(0);
+    for (size_t cost = 0; cost < limit; ++cost) {
+        for (size_t i = 0; i < queue[cost].size(); ++i) {
+            size_t step = queue[cost][i];
+            uint64_t stack = steps[step].stack;
+            if (cheapest[stack] != cost) continue;
+            if (stack == end) {
+                std::vector<Instruction> code;
+                for (; step != 0; step = steps[step].parent) {
+                    const auto& move = moves[steps[step].move];
+                    code.insert(code.begin(), move.begin(), move.end());
+                }
+                return code;
+            }
+
+            auto reach = [&](uint64_t next, size_t move) {
+                size_t total = cost + moves[move].size();
+                if (total >= limit || height(next) > tallest) return;
+                // A value found on the stack cannot be had again once the last copy of it is dropped.
+                for (uint64_t reg: needed) {
+                    size_t k = 0;
+                    while (k < height(next) && at(next, k) != reg) ++k;
+                    if (k == height(next)) return;
+                }
+                if (auto seen = cheapest.find(next); seen != cheapest.end() && seen->second <= total) return;
+                cheapest[next] = total;
+                steps.push_back({ next, step, move });
+                queue[total].push_back(steps.size() - 1);
+            };
+            for (size_t p = 0; p < pushed.size(); ++p) reach(push(stack, pushed[p]), p);
+            size_t n = height(stack);
+            if (n == 0) continue;
+            reach(put(stack - 1, n - 1, 0), pop);
+            for (size_t depth = 0; depth < n; ++depth) {
+                if (depth == 0 ? mShuffles.dup == nullptr : mShuffles.nth == nullptr) continue;
+                reach(push(stack, at(stack, n - 1 - depth)), copy + depth);
+            }
+            if (n >= 2 && mShuffles.swap != nullptr) {
+                reach(put(put(stack, n - 1, at(stack, n - 2)), n - 2, at(stack, n - 1)), swap);
+            }
+            if (n >= 3 && mShuffles.rot != nullptr) {
+                reach(put(put(put(stack, n - 1, at(stack, n - 3)), n - 2, at(stack, n - 1)), n - 3, at(stack, n - 2)), swap + 1);
+            }
+            if (n >= 3 && mShuffles.rrot != nullptr) {
+                reach(put(put(put(stack, n - 1, at(stack, n - 2)), n - 2, at(stack, n - 3)), n - 3, at(stack, n - 1)), swap + 2);
+            }
+            if (steps.size() > StateLimit) return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+// Stack code for the word again: each run that shuffled as the shortest code found for it, if shorter than what it
+// came from, and every jump moved to where what it landed on now is.
+std::vector<Instruction> RegisterForm::raise() const {
+    std::vector<Instruction> block;
+    std::vector<size_t> moved(mBlock.size() + 1, 0);
+    std::vector<std::pair<size_t, size_t>> jumping;   // new place, old place
+    auto run = mRuns.begin();
+    for (size_t pc = 0; pc < mBlock.size(); ) {
+        moved[pc] = block.size();
+        if (run == mRuns.end() || run->from != pc) {
+            if (jumps(mBlock[pc])) jumping.emplace_back(block.size(), pc);
+            block.push_back(mBlock[pc++]);
+            continue;
+        }
+        auto code = run->shuffles ? schedule(*run, run->to - run->from) : std::nullopt;
+        if (code.has_value()) block.insert(block.end(), code->begin(), code->end());
+        else block.insert(block.end(), mBlock.begin() + ptrdiff_t(run->from), mBlock.begin() + ptrdiff_t(run->to));
+        pc = run->to;
+        ++run;
+    }
+    moved[mBlock.size()] = block.size();
+    for (auto [now, was]: jumping) {
+        if (ptrdiff_t to = ptrdiff_t(was) + 1 + mBlock[was].by(); to >= 0 && size_t(to) <= mBlock.size()) {
+            block[now].setBy(int(ptrdiff_t(moved[size_t(to)]) - ptrdiff_t(now) - 1));
+        }
+    }
+    return block;
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Fifth.h"
+
+#include <compare>
+#include <optional>
+#include <vector>
+
+namespace Fifth {
+
+// A compiled word in register form, where its stack shuffles can be taken apart. Each straight run of pushes and
+// shuffles becomes a Run whose values are registers: those it found on the stack and those it pushed. dup and nth by a
+// literal make copies of registers; swap, pop, rot and rrot only move them about. Every other instruction stays as it
+// was and sees the stack exactly as the stack code left it, so an error raised anywhere finds the same stack.
+//
+//     the constructor  lowers stack code to runs of registers
+//     propagate()      makes what a copy leaves what it copied
+//     prune()          drops registers nothing is left holding, with the pushes and shuffles that made them
+//     raise()          gives stack code again, each run the shortest code found that leaves the same registers
+class RegisterForm {
+public:
+    // A value in a run: the n-th from the top of the stack when the run began, or that of the run's n-th node.
+    struct Reg {
+          bool found = false;
+        size_t n = 0;
+
+        auto operator<=>(const Reg&) const = default;
+    };
+
+    // A register the run pushed, or a copy of another.
+    struct Node {
+        Compiled::Instruction push { Compiled::NOP };   // PUSH, LOCAL or GLOBAL; NOP for a copy
+                          Reg from;                     // what a copy copies
+                         bool live = true;
+    };
+
+    struct Run {
+                   size_t from = 0;       // the stack code it was lowered from, from up to to
+                   size_t to = 0;
+                   size_t found = 0;      // values it took off the stack; those below it left alone
+                     bool shuffles = false;
+        std::vector<Node> nodes;
+         std::vector<Reg> leaves;         // what it leaves in place of those it took, bottom first
+    };
+
+private:
+    // The builtins a run is raised with, null where one has been defined over.
+    struct Shuffles {
+        Code* dup = nullptr;
+        Code* nth = nullptr;
+        Code* pop = nullptr;
+        Code* rot = nullptr;
+        Code* rrot = nullptr;
+        Code* swap = nullptr;
+    };
+
+    std::vector<Compiled::Instruction> mBlock;
+                      std::vector<Run> mRuns;
+                              Shuffles mShuffles;
+
+    std::optional<std::vector<Compiled::Instruction>> schedule(const Run& run, size_t limit) const;
+
+public:
+    RegisterForm(VM* vm, const std::vector<Compiled::Instruction>& block);
+
+    const std::vector<Run>& runs() const { return mRuns; }
+
+                                  void propagate();
+                                  void prune();
+    std::vector<Compiled::Instruction> raise() const;
+};
+
+}
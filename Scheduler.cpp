@@ -0,0 +1,109 @@
+#include "Scheduler.h"
+
+Fifth::Scheduler::Scheduler(size_t workers) {
+    for (size_t n = 0; n < std::max(workers, size_t(1)); ++n) mWorkers.push_back(std::make_unique<Worker>());
+}
+
+Fifth::Channel* Fifth::Scheduler::channel(const String& name, size_t capacity) {
+    mChannels.emplace_back(name, std::make_unique<Channel>(capacity));
+    return mChannels.back().second.get();
+}
+
+// Makes a VM per worker, gives it the compile cache if there is one, binds the channels and hands it to setup, then
+// runs until every task has finished or all that are left wait on each other. Returns false if a task failed, a VM ran
+// out of a limit or the tasks deadlocked; errors() says which.
+bool Fifth::Scheduler::run(const std::function<void(VM&)>& setup) {
+    mErrors.clear();
+    mDeadlock = false;
+    mEpoch = 0;
+    for (auto& w: mWorkers) {
+        w->vm = std::make_unique<VM>();
+        w->vm->cache(mCache);
+        for (auto& [name, ch]: mChannels) *w->vm->global(w->vm->declare(name)) = static_cast<External*>(ch.get());
+        setup(*w->vm);
+        w->stalledAt = VM::npos;
+        w->done = false;
+        w->error.clear();
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t n = 0; n < mWorkers.size(); ++n) threads.emplace_back(&Scheduler::work, this, n);
+    for (auto& t: threads) t.join();
+
+    for (auto& w: mWorkers) {
+        if (!w->error.empty()) mErrors.push_back(w->error);
+        else if (!w->vm->error().empty()) mErrors.push_back(w->vm->error());
+        w->queue.clear();
+    }
+    mQueued = 0;
+    if (mDeadlock) mErrors.push_back(L"every task is waiting on a channel");
+    return mErrors.empty();
+}
+
+// Queues a word to run as a task. Call before run(); words are dealt out to the workers in turn.
+void Fifth::Scheduler::spawn(const String& word) {
+    mWorkers[mNext++ % mWorkers.size()]->queue.push_back(word);
+    ++mQueued;
+}
+
+// Records that a worker's round, begun at epoch, got nowhere. The tasks are deadlocked once every worker still running
+// has stalled since the last round that moved, with nothing left to start. A round that began before another moved may
+// have missed what that one sent, so it counts for the epoch it began at.
+bool Fifth::Scheduler::stalled(size_t me, uint64_t epoch) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mWorkers[me]->stalledAt = epoch;
+    epoch = mEpoch;
+    if (mQueued != 0) return false;
+    for (const auto& w: mWorkers) if (!w->done && w->stalledAt != epoch) return false;
+    mDeadlock = true;
+    return true;
+}
+
+std::optional<Fifth::String> Fifth::Scheduler::take(size_t me, bool steal) {
+    if (mQueued == 0) return std::nullopt;
+    for (size_t n = 0; n < (steal ? mWorkers.size() : 1); ++n) {
+        Worker& w = *mWorkers[(me + n) % mWorkers.size()];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (w.queue.empty()) continue;
+        String word = n == 0 ? w.queue.front() : w.queue.back();
+        if (n == 0) w.queue.pop_front();
+        else w.queue.pop_back();
+        --mQueued;
+        return word;
+    }
+    return std::nullopt;
+}
+
+void Fifth::Scheduler::work(size_t me) {
+    Worker& worker = *mWorkers[me];
+    VM& vm = *worker.vm;
+    try {
+        while (!mDeadlock) {
+            if (auto word = take(me, vm.tasks() == 0); word.has_value()) vm.spawn(word.value());
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                worker.stalledAt = VM::npos;
+            }
+            uint64_t epoch = mEpoch;
+            switch (vm.round()) {
+            case VM::IDLE:
+                if (mQueued == 0) {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    worker.done = true;
+                    return;
+                }
+                break;
+            case VM::PROGRESS: ++mEpoch;                                                  break;
+            case VM::SLEEPING: std::this_thread::sleep_for(std::chrono::milliseconds(1)); break;
+            case VM::STALLED:
+                if (stalled(me, epoch)) return;
+                std::this_thread::yield();
+                break;
+            }
+        }
+    } catch (const Error& e) {
+        worker.error = e.message();
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    worker.done = true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "CompileCache.h"
+#include "Fifth.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace Fifth {
+
+// Runs tasks on a pool of threads, each with a VM of its own prepared by the same setup, which should define the words
+// the tasks run. Channels made here are bound as globals in every VM, so tasks on different threads can talk.
+// A worker gives its VM's tasks a round at a time and starts one queued word per round; once its VM has nothing left
+// to run it steals queued words from the back of the other workers' queues. Only words not yet started move between
+// threads, since a started task's frames and calls belong to its VM.
+class Scheduler {
+private:
+    struct Worker {
+         std::unique_ptr<VM> vm;
+                  std::mutex mutex;   // guards queue
+          std::deque<String> queue;
+                    uint64_t stalledAt = VM::npos;
+                        bool done = false;
+                      String error;
+    };
+
+                                       CompileCache* mCache = nullptr;
+    std::vector<std::pair<String, std::unique_ptr<Channel>>> mChannels;
+                                   std::atomic<bool> mDeadlock = false;
+                               std::atomic<uint64_t> mEpoch = 0;  // bumped by every round that got somewhere
+                                 std::vector<String> mErrors;
+                                          std::mutex mMutex;      // guards stalledAt and done
+                                              size_t mNext = 0;
+                                 std::atomic<size_t> mQueued = 0;
+                 std::vector<std::unique_ptr<Worker>> mWorkers;
+
+public:
+    Scheduler(size_t workers = std::thread::hardware_concurrency());
+
+    NO(Scheduler);
+
+                        void cache(CompileCache* c) { mCache = c; }
+                    Channel* channel(const String& name, size_t capacity);
+    const std::vector<String>& errors() const { return mErrors; }
+                        bool run(const std::function<void(VM&)>& setup);
+                        void spawn(const String& word);
+
+private:
+                        bool stalled(size_t me, uint64_t epoch);
+       std::optional<String> take(size_t me, bool steal);
+                        void work(size_t me);
+};
+
+}
@@ -0,0 +1,431 @@
+#include "Simd.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIFTH_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Fifth::Simd {
+
+static constexpr size_t Width = sizeof(wchar_t);
+
+static size_t scalarFind(const wchar_t* str, size_t len, const wchar_t* sub, size_t subLen) {
+    for (size_t i = 0; i + subLen <= len; ++i) {
+        const wchar_t* at = wmemchr(str + i, sub[0], len - subLen + 1 - i);
+        if (at == nullptr) break;
+        i = size_t(at - str);
+        if (wmemcmp(at + 1, sub + 1, subLen - 1) == 0) return i;
+    }
+    return npos;
+}
+
+static size_t scalarMismatch(const wchar_t* left, const wchar_t* right, size_t len) {
+    for (size_t i = 0; i < len; ++i) if (left[i] != right[i]) return i;
+    return npos;
+}
+
+static void scalarLower(wchar_t* str, size_t len) {
+    for (size_t i = 0; i < len; ++i) str[i] = wchar_t(towlower(wint_t(str[i])));
+}
+
+static void scalarUpper(wchar_t* str, size_t len) {
+    for (size_t i = 0; i < len; ++i) str[i] = wchar_t(towupper(wint_t(str[i])));
+}
+
+#ifdef FIFTH_SIMD_X86
+
+// Lane helpers: a lane is one wchar_t, so 16 or 32 bit depending on the platform.
+
+__attribute__((target("sse2"))) static inline __m128i splat(wchar_t c) {
+    if constexpr (Width == 4) return _mm_set1_epi32(int(c));
+    else return _mm_set1_epi16(short(c));
+}
+
+__attribute__((target("sse2"))) static inline __m128i same(__m128i a, __m128i b) {
+    if constexpr (Width == 4) return _mm_cmpeq_epi32(a, b);
+    else return _mm_cmpeq_epi16(a, b);
+}
+
+__attribute__((target("sse2"))) static inline __m128i above(__m128i a, __m128i b) {
+    if constexpr (Width == 4) return _mm_cmpgt_epi32(a, b);
+    else return _mm_cmpgt_epi16(a, b);
+}
+
+__attribute__((target("avx2"))) static inline __m256i splat256(wchar_t c) {
+    if constexpr (Width == 4) return _mm256_set1_epi32(int(c));
+    else return _mm256_set1_epi16(short(c));
+}
+
+__attribute__((target("avx2"))) static inline __m256i same256(__m256i a, __m256i b) {
+    if constexpr (Width == 4) return _mm256_cmpeq_epi32(a, b);
+    else return _mm256_cmpeq_epi16(a, b);
+}
+
+__attribute__((target("avx2"))) static inline __m256i above256(__m256i a, __m256i b) {
+    if constexpr (Width == 4) return _mm256_cmpgt_epi32(a, b);
+    else return _mm256_cmpgt_epi16(a, b);
+}
+
+// Byte mask -> lane index, and clearing every byte bit of the lowest set lane.
+static inline size_t lane(uint64_t mask)      { return size_t(__builtin_ctzll(mask)) / Width; }
+static inline uint64_t nextLane(uint64_t mask) { return mask & ~((uint64_t(1) << ((lane(mask) + 1) * Width)) - 1); }
+
+// Substring search: filter candidates on first and last character, then verify the middle.
+__attribute__((target("sse2"))) static size_t sse2Find(const wchar_t* str, size_t len, const wchar_t* sub, size_t subLen) {
+    constexpr size_t Lanes = sizeof(__m128i) / Width;
+    const __m128i first = splat(sub[0]);
+    const __m128i last = splat(sub[subLen - 1]);
+    size_t i = 0;
+    for (; i + subLen - 1 + Lanes <= len; i += Lanes) {
+        __m128i head = _mm_loadu_si128((const __m128i*)(str + i));               // NOLINT
+        __m128i tail = _mm_loadu_si128((const __m128i*)(str + i + subLen - 1));  // NOLINT
+        auto mask = uint64_t(unsigned(_mm_movemask_epi8(_mm_and_si128(same(head, first), same(tail, last)))));
+        for (; mask != 0; mask = nextLane(mask)) {
+            size_t at = i + lane(mask);
+            if (subLen < 3 || wmemcmp(str + at + 1, sub + 1, subLen - 2) == 0) return at;
+        }
+    }
+    size_t rest = scalarFind(str + i, len - i, sub, subLen);
+    return rest == npos ? npos : i + rest;
+}
+
+__attribute__((target("avx2"))) static size_t avx2Find(const wchar_t* str, size_t len, const wchar_t* sub, size_t subLen) {
+    constexpr size_t Lanes = sizeof(__m256i) / Width;
+    const __m256i first = splat256(sub[0]);
+    const __m256i last = splat256(sub[subLen - 1]);
+    size_t i = 0;
+    for (; i + subLen - 1 + Lanes <= len; i += Lanes) {
+        __m256i head = _mm256_loadu_si256((const __m256i*)(str + i));              // NOLINT
+        __m256i tail = _mm256_loadu_si256((const __m256i*)(str + i + subLen - 1)); // NOLINT
+        auto mask = uint64_t(unsigned(_mm256_movemask_epi8(_mm256_and_si256(same256(head, first), same256(tail, last)))));
+        for (; mask != 0; mask = nextLane(mask)) {
+            size_t at = i + lane(mask);
+            if (subLen < 3 || wmemcmp(str + at + 1, sub + 1, subLen - 2) == 0) return at;
+        }
+    }
+    size_t rest = scalarFind(str + i, len - i, sub, subLen);
+    return rest == npos ? npos : i + rest;
+}
+
+__attribute__((target("sse2"))) static size_t sse2Mismatch(const wchar_t* left, const wchar_t* right, size_t len) {
+    constexpr size_t Lanes = sizeof(__m128i) / Width;
+    size_t i = 0;
+    for (; i + Lanes <= len; i += Lanes) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(left + i));  // NOLINT
+        __m128i b = _mm_loadu_si128((const __m128i*)(right + i)); // NOLINT
+        auto mask = uint64_t(unsigned(~_mm_movemask_epi8(same(a, b))) & 0xFFFFU);
+        if (mask != 0) return i + lane(mask);
+    }
+    size_t rest = scalarMismatch(left + i, right + i, len - i);
+    return rest == npos ? npos : i + rest;
+}
+
+__attribute__((target("avx2"))) static size_t avx2Mismatch(const wchar_t* left, const wchar_t* right, size_t len) {
+    constexpr size_t Lanes = sizeof(__m256i) / Width;
+    size_t i = 0;
+    for (; i + Lanes <= len; i += Lanes) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(left + i));  // NOLINT
+        __m256i b = _mm256_loadu_si256((const __m256i*)(right + i)); // NOLINT
+        auto mask = uint64_t(~unsigned(_mm256_movemask_epi8(same256(a, b))));
+        if (mask != 0) return i + lane(mask);
+    }
+    size_t rest = scalarMismatch(left + i, right + i, len - i);
+    return rest == npos ? npos : i + rest;
+}
+
+// ASCII letters are flipped in registers; a block holding anything outside ASCII goes to towlower/towupper.
+__attribute__((target("sse2"))) static void sse2Case(wchar_t* str, size_t len, bool toUpper) {
+    constexpr size_t Lanes = sizeof(__m128i) / Width;
+    const __m128i from = splat(toUpper ? L'a' - 1 : L'A' - 1);
+    const __m128i to = splat(toUpper ? L'z' + 1 : L'Z' + 1);
+    const __m128i bit = splat(0x20);
+    const __m128i high = splat(wchar_t(~0x7F));
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + Lanes <= len; i += Lanes) {
+        __m128i* at = (__m128i*)(str + i);                                                          // NOLINT
+        __m128i v = _mm_loadu_si128(at);
+        if (_mm_movemask_epi8(same(_mm_and_si128(v, high), zero)) != 0xFFFF) {
+            if (toUpper) scalarUpper(str + i, Lanes);
+            else scalarLower(str + i, Lanes);
+            continue;
+        }
+        __m128i flip = _mm_and_si128(_mm_and_si128(above(v, from), above(to, v)), bit);
+        _mm_storeu_si128(at, _mm_xor_si128(v, flip));
+    }
+    if (toUpper) scalarUpper(str + i, len - i);
+    else scalarLower(str + i, len - i);
+}
+
+__attribute__((target("avx2"))) static void avx2Case(wchar_t* str, size_t len, bool toUpper) {
+    constexpr size_t Lanes = sizeof(__m256i) / Width;
+    const __m256i from = splat256(toUpper ? L'a' - 1 : L'A' - 1);
+    const __m256i to = splat256(toUpper ? L'z' + 1 : L'Z' + 1);
+    const __m256i bit = splat256(0x20);
+    const __m256i high = splat256(wchar_t(~0x7F));
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + Lanes <= len; i += Lanes) {
+        __m256i* at = (__m256i*)(str + i);                                                          // NOLINT
+        __m256i v = _mm256_loadu_si256(at);
+        if (unsigned(_mm256_movemask_epi8(same256(_mm256_and_si256(v, high), zero))) != 0xFFFFFFFFU) {
+            if (toUpper) scalarUpper(str + i, Lanes);
+            else scalarLower(str + i, Lanes);
+            continue;
+        }
+        __m256i flip = _mm256_and_si256(_mm256_and_si256(above256(v, from), above256(to, v)), bit);
+        _mm256_storeu_si256(at, _mm256_xor_si256(v, flip));
+    }
+    if (toUpper) scalarUpper(str + i, len - i);
+    else scalarLower(str + i, len - i);
+}
+
+static void sse2Lower(wchar_t* str, size_t len) { sse2Case(str, len, false); }
+static void sse2Upper(wchar_t* str, size_t len) { sse2Case(str, len, true); }
+static void avx2Lower(wchar_t* str, size_t len) { avx2Case(str, len, false); }
+static void avx2Upper(wchar_t* str, size_t len) { avx2Case(str, len, true); }
+
+#endif
+
+// Numeric kernels are written once against GCC vector extensions and instantiated twice: for the baseline
+// ISA and inside target("avx2") wrappers. Compilers without vector extensions get the same code one lane wide.
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wpsabi"  // wide vectors never cross a call boundary, everything below is inlined
+typedef double    Reals    __attribute__((vector_size(32)));
+typedef long long Integers __attribute__((vector_size(32)));
+#define FIFTH_INLINE inline __attribute__((always_inline))
+#else
+typedef double    Reals;
+typedef long long Integers;
+#define FIFTH_INLINE inline
+#endif
+
+struct Add          { template <class V> static FIFTH_INLINE V run(const V& a, const V& b)    { return a + b; } };
+struct Subtract     { template <class V> static FIFTH_INLINE V run(const V& a, const V& b)    { return a - b; } };
+struct Multiply     { template <class V> static FIFTH_INLINE V run(const V& a, const V& b)    { return a * b; } };
+struct Divide       { template <class V> static FIFTH_INLINE V run(const V& a, const V& b)    { return a / b; } };
+struct Less         { template <class V> static FIFTH_INLINE auto run(const V& a, const V& b) { return a < b; } };
+struct LessEqual    { template <class V> static FIFTH_INLINE auto run(const V& a, const V& b) { return a <= b; } };
+struct Greater      { template <class V> static FIFTH_INLINE auto run(const V& a, const V& b) { return a > b; } };
+struct GreaterEqual { template <class V> static FIFTH_INLINE auto run(const V& a, const V& b) { return a >= b; } };
+
+template <class V, class T> static FIFTH_INLINE V load(const T* at) { V v; memcpy(&v, at, sizeof(V)); return v; }
+template <class V, class T> static FIFTH_INLINE void store(T* at, const V& v) { memcpy(at, &v, sizeof(V)); }
+
+template <class T, class V, class F>
+static FIFTH_INLINE void binary(T* dst, const T* src, T scalar, size_t len) {
+    constexpr size_t Lanes = sizeof(V) / sizeof(T);
+    const V all = V{} + scalar;
+    size_t i = 0;
+    if (src != nullptr) for (; i + Lanes <= len; i += Lanes) store(dst + i, F::run(load<V>(dst + i), load<V>(src + i)));
+    else for (; i + Lanes <= len; i += Lanes) store(dst + i, F::run(load<V>(dst + i), all));
+    for (; i < len; ++i) dst[i] = F::run(dst[i], src != nullptr ? src[i] : scalar);
+}
+
+template <class T, class V, class F>
+static FIFTH_INLINE void test(long long* out, const T* left, const T* right, T scalar, size_t len) {
+    constexpr size_t Lanes = sizeof(V) / sizeof(T);
+    const V all = V{} + scalar;
+    size_t i = 0;
+    for (; i + Lanes <= len; i += Lanes) {
+        auto mask = (Integers) F::run(load<V>(left + i), right != nullptr ? load<V>(right + i) : all);
+        store(out + i, mask & 1);
+    }
+    for (; i < len; ++i) out[i] = F::run(left[i], right != nullptr ? right[i] : scalar) ? 1 : 0;
+}
+
+template <class T, class V>
+static FIFTH_INLINE void apply(Op op, T* dst, const T* src, T scalar, size_t len) {
+    switch (op) {
+    case ADD:      binary<T, V, Add>(dst, src, scalar, len);      break;
+    case SUBTRACT: binary<T, V, Subtract>(dst, src, scalar, len); break;
+    case MULTIPLY: binary<T, V, Multiply>(dst, src, scalar, len); break;
+    case DIVIDE:   binary<T, V, Divide>(dst, src, scalar, len);   break;
+    default:                                                      break;
+    }
+}
+
+template <class T, class V>
+static FIFTH_INLINE void compare(Op op, long long* out, const T* left, const T* right, T scalar, size_t len) {
+    switch (op) {
+    case LESS:          test<T, V, Less>(out, left, right, scalar, len);         break;
+    case LESS_EQUAL:    test<T, V, LessEqual>(out, left, right, scalar, len);    break;
+    case GREATER:       test<T, V, Greater>(out, left, right, scalar, len);      break;
+    case GREATER_EQUAL: test<T, V, GreaterEqual>(out, left, right, scalar, len); break;
+    default:                                                                     break;
+    }
+}
+
+template <class T, class V>
+static FIFTH_INLINE T sum(const T* src, size_t len) {
+    constexpr size_t Lanes = sizeof(V) / sizeof(T);
+    V acc = V{};
+    size_t i = 0;
+    for (; i + Lanes <= len; i += Lanes) acc += load<V>(src + i);
+    T total = 0;
+    for (size_t j = 0; j < Lanes; ++j) total += ((const T*) &acc)[j];                  // NOLINT
+    for (; i < len; ++i) total += src[i];
+    return total;
+}
+
+template <class T, class V>
+static FIFTH_INLINE T dot(const T* left, const T* right, size_t len) {
+    constexpr size_t Lanes = sizeof(V) / sizeof(T);
+    V acc = V{};
+    size_t i = 0;
+    for (; i + Lanes <= len; i += Lanes) acc += load<V>(left + i) * load<V>(right + i);
+    T total = 0;
+    for (size_t j = 0; j < Lanes; ++j) total += ((const T*) &acc)[j];                  // NOLINT
+    for (; i < len; ++i) total += left[i] * right[i];
+    return total;
+}
+
+template <class T, class V, bool Least>
+static FIFTH_INLINE T extreme(const T* src, size_t len) {
+    constexpr size_t Lanes = sizeof(V) / sizeof(T);
+    if (len == 0) return 0;
+    V acc = V{} + src[0];
+    size_t i = 0;
+    for (; i + Lanes <= len; i += Lanes) {
+        V v = load<V>(src + i);
+        acc = (Least ? v < acc : v > acc) ? v : acc;
+    }
+    T best = src[0];
+    for (size_t j = 0; j < Lanes; ++j) if (T x = ((const T*) &acc)[j]; Least ? x < best : x > best) best = x; // NOLINT
+    for (; i < len; ++i) if (Least ? src[i] < best : src[i] > best) best = src[i];
+    return best;
+}
+
+#define FIFTH_NUMERIC_KERNELS(prefix, attr)                                                                                                                  \
+attr static void prefix##ApplyReal(Op o, double* d, const double* s, double k, size_t n)                 { apply<double, Reals>(o, d, s, k, n); }            \
+attr static void prefix##ApplyInteger(Op o, long long* d, const long long* s, long long k, size_t n)     { apply<long long, Integers>(o, d, s, k, n); }      \
+attr static void prefix##CompareReal(Op o, long long* r, const double* a, const double* b, double k, size_t n) { compare<double, Reals>(o, r, a, b, k, n); } \
+attr static void prefix##CompareInteger(Op o, long long* r, const long long* a, const long long* b, long long k, size_t n) { compare<long long, Integers>(o, r, a, b, k, n); } \
+attr static double prefix##DotReal(const double* a, const double* b, size_t n)                           { return dot<double, Reals>(a, b, n); }              \
+attr static long long prefix##DotInteger(const long long* a, const long long* b, size_t n)               { return dot<long long, Integers>(a, b, n); }        \
+attr static double prefix##MaxReal(const double* s, size_t n)                                            { return extreme<double, Reals, false>(s, n); }      \
+attr static long long prefix##MaxInteger(const long long* s, size_t n)                                   { return extreme<long long, Integers, false>(s, n); } \
+attr static double prefix##MinReal(const double* s, size_t n)                                            { return extreme<double, Reals, true>(s, n); }       \
+attr static long long prefix##MinInteger(const long long* s, size_t n)                                   { return extreme<long long, Integers, true>(s, n); }  \
+attr static double prefix##SumReal(const double* s, size_t n)                                            { return sum<double, Reals>(s, n); }                 \
+attr static long long prefix##SumInteger(const long long* s, size_t n)                                   { return sum<long long, Integers>(s, n); }
+
+FIFTH_NUMERIC_KERNELS(base, )
+#ifdef FIFTH_SIMD_X86
+FIFTH_NUMERIC_KERNELS(avx2, __attribute__((target("avx2"))))
+#endif
+
+struct Kernels {
+     Level level;
+    size_t (*find)(const wchar_t*, size_t, const wchar_t*, size_t);
+    size_t (*mismatch)(const wchar_t*, const wchar_t*, size_t);
+      void (*lower)(wchar_t*, size_t);
+      void (*upper)(wchar_t*, size_t);
+
+         void (*applyReal)(Op, double*, const double*, double, size_t);
+         void (*applyInteger)(Op, long long*, const long long*, long long, size_t);
+         void (*compareReal)(Op, long long*, const double*, const double*, double, size_t);
+         void (*compareInteger)(Op, long long*, const long long*, const long long*, long long, size_t);
+       double (*dotReal)(const double*, const double*, size_t);
+    long long (*dotInteger)(const long long*, const long long*, size_t);
+       double (*maxReal)(const double*, size_t);
+    long long (*maxInteger)(const long long*, size_t);
+       double (*minReal)(const double*, size_t);
+    long long (*minInteger)(const long long*, size_t);
+       double (*sumReal)(const double*, size_t);
+    long long (*sumInteger)(const long long*, size_t);
+};
+
+#define FIFTH_NUMERIC_TABLE(prefix)                                                       \
+    prefix##ApplyReal, prefix##ApplyInteger, prefix##CompareReal, prefix##CompareInteger, \
+    prefix##DotReal, prefix##DotInteger, prefix##MaxReal, prefix##MaxInteger,             \
+    prefix##MinReal, prefix##MinInteger, prefix##SumReal, prefix##SumInteger
+
+static const Kernels& kernels() {
+    static const Kernels chosen = []() -> Kernels {
+#ifdef FIFTH_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return { AVX2, avx2Find, avx2Mismatch, avx2Lower, avx2Upper, FIFTH_NUMERIC_TABLE(avx2) };
+        if (__builtin_cpu_supports("sse2")) return { SSE2, sse2Find, sse2Mismatch, sse2Lower, sse2Upper, FIFTH_NUMERIC_TABLE(base) };
+#endif
+        return { SCALAR, scalarFind, scalarMismatch, scalarLower, scalarUpper, FIFTH_NUMERIC_TABLE(base) };
+    }();
+    return chosen;
+}
+
+Level level() {
+    return kernels().level;
+}
+
+size_t find(const wchar_t* str, size_t len, const wchar_t* sub, size_t subLen) {
+    if (subLen == 0) return 0;
+    if (subLen > len) return npos;
+    return kernels().find(str, len, sub, subLen);
+}
+
+size_t mismatch(const wchar_t* left, const wchar_t* right, size_t len) {
+    return kernels().mismatch(left, right, len);
+}
+
+void lower(wchar_t* str, size_t len) {
+    kernels().lower(str, len);
+}
+
+void upper(wchar_t* str, size_t len) {
+    kernels().upper(str, len);
+}
+
+void apply(Op op, double* dst, const double* src, double scalar, size_t len) {
+    kernels().applyReal(op, dst, src, scalar, len);
+}
+
+void apply(Op op, long long* dst, const long long* src, long long scalar, size_t len) {
+    kernels().applyInteger(op, dst, src, scalar, len);
+}
+
+void compare(Op op, long long* out, const double* left, const double* right, double scalar, size_t len) {
+    kernels().compareReal(op, out, left, right, scalar, len);
+}
+
+void compare(Op op, long long* out, const long long* left, const long long* right, long long scalar, size_t len) {
+    kernels().compareInteger(op, out, left, right, scalar, len);
+}
+
+double dot(const double* left, const double* right, size_t len) {
+    return kernels().dotReal(left, right, len);
+}
+
+long long dot(const long long* left, const long long* right, size_t len) {
+    return kernels().dotInteger(left, right, len);
+}
+
+double max(const double* src, size_t len) {
+    return kernels().maxReal(src, len);
+}
+
+long long max(const long long* src, size_t len) {
+    return kernels().maxInteger(src, len);
+}
+
+double min(const double* src, size_t len) {
+    return kernels().minReal(src, len);
+}
+
+long long min(const long long* src, size_t len) {
+    return kernels().minInteger(src, len);
+}
+
+double sum(const double* src, size_t len) {
+    return kernels().sumReal(src, len);
+}
+
+long long sum(const long long* src, size_t len) {
+    return kernels().sumInteger(src, len);
+}
+
+}
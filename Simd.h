@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Fifth::Simd {
+
+enum Level { SCALAR, SSE2, AVX2 };
+enum Op { ADD, SUBTRACT, MULTIPLY, DIVIDE, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+
+static constexpr size_t npos = size_t(-1);
+
+// Kernels work directly on String (std::wstring) storage, whatever the width of wchar_t.
+// The best implementation for the running CPU is picked once, on first use.
+ Level level();
+size_t find(const wchar_t* str, size_t len, const wchar_t* sub, size_t subLen);
+size_t mismatch(const wchar_t* left, const wchar_t* right, size_t len);
+  void lower(wchar_t* str, size_t len);
+  void upper(wchar_t* str, size_t len);
+
+// Element-wise kernels over contiguous numeric storage. With src == nullptr the scalar is used for every element.
+     void apply(Op op, double* dst, const double* src, double scalar, size_t len);
+     void apply(Op op, long long* dst, const long long* src, long long scalar, size_t len);
+     void compare(Op op, long long* out, const double* left, const double* right, double scalar, size_t len);
+     void compare(Op op, long long* out, const long long* left, const long long* right, long long scalar, size_t len);
+   double dot(const double* left, const double* right, size_t len);
+long long dot(const long long* left, const long long* right, size_t len);
+   double max(const double* src, size_t len);
+long long max(const long long* src, size_t len);
+   double min(const double* src, size_t len);
+long long min(const long long* src, size_t len);
+   double sum(const double* src, size_t len);
+long long sum(const long long* src, size_t len);
+
+}
@@ -20,7 +20,7 @@ inline std::wstring_convert<converter_type, wchar_t> converter; // NOLINT
 
 class file {
 public:
-    enum mode { Read = 1, Write = 2, Append = 4, Update = 8 };
+    enum mode { Read = 1, Write = 2, Append = 4, Update = 8, Binary = 16 };
 
     std::string mode2Str(mode md) {
         std::string res;
@@ -28,6 +28,7 @@ public:
         else if (md & Write) res = "w";
         else if (md & Append) res = "a";
         if (md & Update) res += "+";
+        if (md & Binary) res += "b";
         return res;
     }
 
@@ -54,6 +55,7 @@ public:
       void clearErrors() { ::clearerr(mFile); }
       bool eof()         { return ::feof(mFile); }
       bool error()       { return ::ferror(mFile); }
+      bool isOpen()      { return mFile != nullptr; }
 
       void flush()        { ::fflush(mFile); }
     size_t postion()      { return ::ftell(mFile); }
@@ -82,7 +84,7 @@ public:
 
     template <typename T>
     size_t write(std::vector<T>& store, size_t from, size_t count) {
-        return fwrite((void*) store.data(), sizeof(T), count, mFile);
+        return fwrite((void*) (store.data() + from), sizeof(T), count, mFile); // NOLINT
     }
 };
 